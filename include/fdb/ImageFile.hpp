@@ -1,6 +1,9 @@
 #pragma once
+#include <memory>
+
 #include "NormalFile.hpp"
 namespace fdb {
+  // loads the redux runtime and makes it the default image decoder, windows only
   extern bool initRedux(const char* path=nullptr);
   class ImageFile : public NormalFile {
   public:
@@ -13,14 +16,56 @@ namespace fdb {
       std::uint8_t unk[3];
     };
 #pragma pack(pop)
+    // view of a single mipmap level of one face inside get()
+    struct Level {
+      std::uint32_t face;
+      std::uint32_t level;
+      std::uint32_t width;
+      std::uint32_t height;
+      std::uint32_t pitch;  // bytes per row, or per row of 4x4 blocks for DXT formats
+      std::size_t offset;   // byte offset into get()
+      std::size_t size;
+      const char* data;
+    };
+    // backend for Compression::redux payloads, decode() has to be callable from several threads at once
+    class Decoder {
+    public:
+      // scratch state of a single decode, never shared between threads
+      class Context {
+      public:
+        virtual ~Context() = default;
+      };
+      virtual ~Decoder() = default;
+      virtual std::unique_ptr<Context> context() const { return nullptr; }
+      // hdr holds the values stored in the archive and receives the layout of out
+      virtual bool decode(Context* ctx, const std::vector<char>& in, Header& hdr, std::vector<char>& out) const = 0;
+    };
+    // process wide decoder used by decompress(), each thread keeps its own context for it
+    static void decoder(std::shared_ptr<const Decoder> decoder);
+    static std::shared_ptr<const Decoder> decoder();
+
   public:
     virtual bool decompress() override;
+    bool decompress(const Decoder& decoder, Decoder::Context* ctx = nullptr);
     virtual bool fromFile(const char*, const char* name) override;
     virtual bool toFile(const char* filename, bool decompress = true) override;
     virtual bool isImage() const override { return true; }
     Header& getHeader() { return mHeader; }
+    const Header& getHeader() const { return mHeader; }
+
+    // only valid for decompressed images, the views point into get() and are invalidated by any modification
+    [[nodiscard]] std::uint32_t faces() const;
+    [[nodiscard]] std::vector<Level> levels() const;
+    [[nodiscard]] Level level(std::uint32_t mipmap, std::uint32_t face = 0) const;
+    // converts all levels to 32 bit A8R8G8B8 (type 4)
+    bool convert();
 
   private:
-    Header mHeader;
+    Header mHeader{};
   };
+
+  // uses the payload as the raw levels described by the header, for tests and uncompressed archives
+  std::shared_ptr<const ImageFile::Decoder> storedDecoder();
+  // nullptr if the redux runtime can't be loaded
+  std::shared_ptr<const ImageFile::Decoder> reduxDecoder(const char* path = nullptr);
 }  // namespace fdb
\ No newline at end of file
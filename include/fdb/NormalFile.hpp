@@ -13,9 +13,9 @@ namespace fdb {
 
     const std::string& name() const { return mName; }
     const std::vector<char>& get() const { return mData; }
-    const std::uint32_t size() const { return mData.size(); }
-    const std::uint32_t compressed_size() const { return mCompressedSize; }
-    const std::uint32_t uncompressed_size() const { return mSize; }
+    const std::uint64_t size() const { return mData.size(); }
+    const std::uint64_t compressed_size() const { return mCompressedSize; }
+    const std::uint64_t uncompressed_size() const { return mSize; }
     Compression compression() const { return mCompression; }
     std::uint64_t time() const { return mTime; }
 
@@ -32,7 +32,7 @@ namespace fdb {
       mData = std::move(_data);
       mSize = mData.size();
     }
-    void data(std::vector<char> _data, Compression c, std::uint32_t size) {
+    void data(std::vector<char> _data, Compression c, std::uint64_t size) {
       if (c == Compression::none) return data(std::move(_data));
       mCompression = c;
       mSize = size;
@@ -45,8 +45,8 @@ namespace fdb {
   protected:
     Compression mCompression{Compression::none};
     std::string mName;
-    std::uint32_t mSize;
-    std::uint32_t mCompressedSize;
+    std::uint64_t mSize;
+    std::uint64_t mCompressedSize;
     std::uint64_t mTime;
     std::vector<char> mData;
   };
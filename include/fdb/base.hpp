@@ -4,21 +4,31 @@
 
 namespace fdb {
   enum class FileType : std::uint32_t { unk, normal, image };
-  enum class Compression : std::uint32_t { none, rle, lzo, zlib, redux };
+  enum class Compression : std::uint32_t { none, rle, lzo, zlib, redux, zstd, lz4 };
+  // classic archives have 32 bit offsets and sizes, extended ones 64 bit
+  enum class Format { classic, extended };
 
 #pragma pack(push, 4)
   struct FileTableEntry {
     FileType type;
     std::uint64_t time;
-    std::uint32_t offset;
+    std::uint64_t offset;
   };
 
   struct FileInfo {
     std::string_view name;
     std::uint64_t time;
+    Compression compression{Compression::none};
+    std::uint64_t compressedSize{0};
+    std::uint64_t expectedSize{0};
+  };
+
+  // where the payload of an entry sits inside the archive
+  struct PayloadLocation {
+    std::uint64_t offset;
+    std::uint64_t size;  // bytes as stored
     Compression compression;
-    std::uint32_t compressedSize;
-    std::uint32_t expectedSize;
+    std::uint64_t expectedSize;
   };
 #pragma pack(pop)
 }  // namespace fdb
\ No newline at end of file
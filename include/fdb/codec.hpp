@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+
+#include "base.hpp"
+
+namespace fdb {
+  // zstd and lz4 entries are split into blocks of this many uncompressed bytes that are compressed on their
+  // own, a block index in front of them allows decoding any part of an entry and all blocks in parallel
+  constexpr std::uint32_t BLOCK_SIZE = 256 * 1024;
+
+  // block codecs are optional dependencies and only allowed in extended archives
+  constexpr bool blockCompressed(Compression compression) {
+    return compression == Compression::zstd || compression == Compression::lz4;
+  }
+  // whether entries of this codec can be compressed and decompressed by this build
+  [[nodiscard]] bool available(Compression compression);
+}  // namespace fdb
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace fdb {
+  // names follow the D3D convention (highest bits first), rgba8 and bgra8 are byte order in memory
+  enum class PixelFormat : std::uint32_t {
+    unk,
+    r5g6b5,
+    a4r4g4b4,
+    a1r5g5b5,
+    r8g8b8,
+    bgra8,  // A8R8G8B8
+    rgba8,
+    dxt1,
+    dxt3,
+    dxt5
+  };
+
+  // maps ImageFile::Header::type
+  PixelFormat pixelFormat(std::uint32_t type);
+  // size of a single level as stored inside an ImageFile
+  std::size_t levelSize(PixelFormat format, std::uint32_t width, std::uint32_t height);
+
+  // converts one level of width * height pixels into rgba8 or bgra8
+  // dst is resized to width * height * 4
+  bool convert(PixelFormat from, const void* src, std::size_t size, std::uint32_t width, std::uint32_t height,
+               PixelFormat to, std::vector<char>& dst);
+
+  namespace reference {
+    // plain per pixel implementation of fdb::convert, the optimized kernels are checked against it
+    bool convert(PixelFormat from, const void* src, std::size_t size, std::uint32_t width, std::uint32_t height,
+                 PixelFormat to, std::vector<char>& dst);
+  }  // namespace reference
+}  // namespace fdb
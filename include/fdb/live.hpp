@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "reader.hpp"
+
+namespace fdb {
+  namespace impl {
+    class Watcher;
+  }
+
+  // an archive that can be replaced on disk while it is being read
+  //
+  // every lookup goes through snapshot(), which hands out the current Reader and never waits for a reload; a
+  // reload opens the new file on the side and swaps it in, older snapshots stay usable until their last holder
+  // lets go of them. Patches have to replace the file (write elsewhere, then rename), an archive that is
+  // overwritten in place breaks the snapshots still reading it.
+  class LiveReader {
+  public:
+    LiveReader();
+    explicit LiveReader(const char* file);
+    ~LiveReader();
+    LiveReader(const LiveReader&) = delete;
+    LiveReader& operator=(const LiveReader&) = delete;
+
+    bool open(const char* file);
+    void close();
+
+    [[nodiscard]] operator bool() const { return snapshot() != nullptr; }
+
+    // the reader to use for a batch of lookups, entry indices are only valid within one snapshot
+    [[nodiscard]] std::shared_ptr<const Reader> snapshot() const { return std::atomic_load(&mCurrent); }
+    // number of snapshots swapped in so far
+    [[nodiscard]] std::uint64_t generation() const { return mGeneration; }
+
+    // opens the file again and swaps it in, keeps the current snapshot if the new file can't be read
+    bool reload();
+    // reloads in the background whenever the file is replaced; inotify on linux, elsewhere the modification
+    // time is checked every interval. callback (optional) runs on the watcher thread after every attempt
+    bool watch(std::function<void(bool)> callback = {},
+               std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+    void unwatch();
+
+  private:
+    std::mutex mReloading;  // one reload at a time, readers never take it
+    std::string mPath;
+    std::shared_ptr<const Reader> mCurrent;  // accessed with std::atomic_load/store only
+    std::atomic<std::uint64_t> mGeneration{0};
+    std::unique_ptr<impl::Watcher> mWatcher;
+  };
+}  // namespace fdb
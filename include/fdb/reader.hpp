@@ -1,13 +1,22 @@
 #pragma once
-#include <fstream>
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <vector>
 
 #include "NormalFile.hpp"
 #include "base.hpp"
+#include "source.hpp"
+#include "trace.hpp"
 
 namespace fdb {
+  namespace impl {
+    class Checkpoints;
+    class Prefetcher;
+    class Table;
+  }
   class NormalFile;
   class Reader {
   protected:
@@ -96,28 +105,80 @@ namespace fdb {
     };
 
   public:
-    Reader() = default;
-    explicit Reader(const char* file) { open(file); }
+    // receives consecutive chunks of an entry, returns false to stop
+    using Sink = std::function<bool(const char* data, std::size_t size)>;
 
-    bool open(const char* file);
+  public:
+    Reader();
+    explicit Reader(const char* file, const char* index = nullptr);
+    explicit Reader(std::shared_ptr<const Source> source);
+    ~Reader();
+
+    // with an index file the table is mapped from it instead of being parsed, every process opening the
+    // archive with the same index shares that memory, a missing or stale index is written first
+    bool open(const char* file, const char* index = nullptr);
+    // an archive in memory, in a part of a larger file or inside another archive, nothing is copied
+    bool open(std::shared_ptr<const Source> source);
     void close();
 
-    [[nodiscard]] operator bool() const { return !mFileTable.empty(); };
+    [[nodiscard]] operator bool() const;
 
     [[nodiscard]] FileInfo info(int index) const;
+    // false for empty or damaged entries
+    [[nodiscard]] bool locate(int index, PayloadLocation& location) const;
     [[nodiscard]] std::unique_ptr<NormalFile> get(int index) const;
+    // the decompressed bytes of an entry, a stored entry is a range of this archive's source and stays valid
+    // after close(), others are decompressed into memory; nullptr for empty or damaged entries
+    // Reader(rd.source(i)) opens an archive nested in another one
+    [[nodiscard]] std::shared_ptr<const Source> source(int index) const;
+    // up to length bytes of the decompressed entry starting at offset, out is shorter at the end of the entry
+    // stored entries read only that slice, zlib entries are inflated just as far as the range goes
+    [[nodiscard]] bool readRange(int index, std::uint64_t offset, std::size_t length, std::vector<char>& out) const;
+    // zlib entries keep an inflate checkpoint (32 KB each) every interval decompressed bytes, so later
+    // ranges start from the nearest one instead of the beginning, 0 (the default) turns them off
+    void checkpoints(std::uint64_t interval);
+    // decompresses an entry into sink in chunks of at most bufferSize bytes, stored and zlib entries never hold
+    // more than two buffers in memory no matter how large they are, false if the sink stopped early
+    [[nodiscard]] bool stream(int index, const Sink& sink, std::size_t bufferSize = 64 * 1024) const;
     [[nodiscard]] int index(const char* name) const noexcept;
-    [[nodiscard]] std::uint32_t size() const noexcept { return mFileTable.size(); }
+    [[nodiscard]] std::uint32_t size() const noexcept;
+    [[nodiscard]] Format format() const noexcept { return mFormat; }
+    [[nodiscard]] FileTableEntry entry(int index) const;
+    [[nodiscard]] const char* name(int index) const;
+    // names as the archive stores them, before normalizing, read from the archive again on every call
+    // empty if the table can't be read
+    [[nodiscard]] std::vector<std::string> storedNames() const;
+    // memory of the file table and names, and whether it is a mapped index shared with other processes
+    [[nodiscard]] std::size_t tableBytes() const noexcept;
+    [[nodiscard]] bool sharedTable() const noexcept;
 
     [[nodiscard]] ItProxy<InfoIterator> InfoIt() { return ItProxy<InfoIterator>(this); }
     [[nodiscard]] ItProxy<FileIterator> FileIt() { return ItProxy<FileIterator>(this); }
 
+    // records every get(), info(), locate() and readRange() until stopTrace()
+    void startTrace();
+    AccessTrace stopTrace();
+    // replays a trace from an earlier run as read-ahead in the background, until stopPrefetch() or close()
+    bool prefetch(const AccessTrace& trace, const PrefetchOptions& options = {});
+    void stopPrefetch();
+    // bytes the prefetcher has pulled in so far
+    [[nodiscard]] std::uint64_t prefetched() const;
+
   protected:
+  private:
+    void accessed(int index, std::uint64_t bytes) const;
+    bool payload(int index, PayloadLocation& location) const;
+    // sources can be read from any thread, no lock needed
+    bool read(std::uint64_t offset, char* data, std::size_t size) const;
+
   private:
     mutable std::mutex mCriticalSection;  // multithreading safety
-    mutable std::ifstream mPackage;
-    std::vector<FileTableEntry> mFileTable;
-    std::vector<char*> mFileNames;
-    std::unique_ptr<char[]> mNames;
+    std::shared_ptr<const Source> mSource;
+    Format mFormat{Format::classic};
+    std::unique_ptr<AccessTrace> mTrace;  // guarded by mCriticalSection
+    std::chrono::steady_clock::time_point mTraceStart;
+    std::unique_ptr<impl::Prefetcher> mPrefetcher;
+    std::shared_ptr<impl::Checkpoints> mCheckpoints;  // guarded by mCriticalSection
+    std::unique_ptr<impl::Table> mTable;
   };
 }  // namespace fdb
\ No newline at end of file
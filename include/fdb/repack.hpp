@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "base.hpp"
+
+namespace fdb {
+  class Reader;
+
+  struct RepackOptions {
+    enum class Grouping { original, offset, directory, extension };
+
+    // names in access order, their payloads are placed first and in this order
+    std::vector<std::string> trace;
+    // layout of everything not in the trace, directory and extension keep the old offset order inside a group
+    Grouping grouping{Grouping::directory};
+    bool recompress{false};
+    Compression compression{Compression::zlib};  // target codec for normal entries when recompressing, see available()
+    unsigned threads{0};                         // recompression workers, 0 = one per hardware thread
+    std::size_t memoryLimit{64 * 1024 * 1024};   // payload bytes held between reading and writing
+    Format format{Format::classic};              // of the new archive, converts between the two as a side effect
+  };
+
+  struct RepackStats {
+    std::uint32_t entries{0};
+    std::uint32_t empty{0};
+    std::uint32_t recompressed{0};
+    std::uint64_t bytesIn{0};
+    std::uint64_t bytesOut{0};
+    double seconds{0};
+  };
+
+  // payload order of the new archive, table indices are kept as they are
+  std::vector<int> repackOrder(const Reader& rd, const RepackOptions& options);
+  // rewrites source into target with the payloads laid out in repackOrder(), names are kept as they are stored
+  // fails on an entry whose payload can't be read instead of writing it empty
+  bool repack(const char* source, const char* target, const RepackOptions& options = {},
+              RepackStats* stats = nullptr);
+}  // namespace fdb
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#ifdef _WIN32
+#include <fstream>
+#include <mutex>
+#endif
+
+namespace fdb {
+  // random access bytes a Reader reads an archive from
+  // read() may be called from several threads at once, every source below allows that
+  class Source {
+  public:
+    virtual ~Source() = default;
+
+    [[nodiscard]] virtual std::uint64_t size() const = 0;
+    // exactly size bytes at offset, false if they aren't all there
+    [[nodiscard]] virtual bool read(std::uint64_t offset, char* data, std::size_t size) const = 0;
+    // all bytes if the source has them in memory, nullptr otherwise
+    [[nodiscard]] virtual const char* data() const { return nullptr; }
+    // hint that the bytes will be read soon, false if the source can't take hints and has to be read instead
+    virtual bool willNeed(std::uint64_t /*offset*/, std::uint64_t /*size*/) const { return false; }
+  };
+
+  // reads a file with pread, concurrent reads don't wait for each other (on windows they seek under a lock)
+  class FileSource : public Source {
+  public:
+    explicit FileSource(const char* file);
+#ifndef _WIN32
+    // the descriptor is duplicated, the caller keeps and closes its own
+    explicit FileSource(int fd);
+#endif
+    ~FileSource() override;
+    FileSource(const FileSource&) = delete;
+    FileSource& operator=(const FileSource&) = delete;
+
+    [[nodiscard]] operator bool() const;
+
+    std::uint64_t size() const override { return mSize; }
+    bool read(std::uint64_t offset, char* data, std::size_t size) const override;
+    bool willNeed(std::uint64_t offset, std::uint64_t size) const override;
+
+  private:
+#ifndef _WIN32
+    int mFile{-1};
+#else
+    mutable std::mutex mCriticalSection;
+    mutable std::ifstream mFile;
+#endif
+    std::uint64_t mSize{0};
+  };
+
+  // bytes already in memory, either borrowed (they have to outlive the source and every reader of it) or owned
+  class MemorySource : public Source {
+  public:
+    MemorySource(const void* data, std::size_t size);
+    explicit MemorySource(std::vector<char> data);
+
+    std::uint64_t size() const override { return mSize; }
+    bool read(std::uint64_t offset, char* data, std::size_t size) const override;
+    const char* data() const override { return mData; }
+    // nothing to pull in
+    bool willNeed(std::uint64_t, std::uint64_t) const override { return true; }
+
+  private:
+    std::vector<char> mOwned;
+    const char* mData;
+    std::size_t mSize;
+  };
+
+  // a whole file mapped read only, every reader of it shares the pages with the page cache
+  // on windows the file is read into memory instead
+  class MappedSource : public Source {
+  public:
+    explicit MappedSource(const char* file);
+    ~MappedSource() override;
+    MappedSource(const MappedSource&) = delete;
+    MappedSource& operator=(const MappedSource&) = delete;
+
+    [[nodiscard]] operator bool() const { return mData != nullptr; }
+
+    std::uint64_t size() const override { return mSize; }
+    bool read(std::uint64_t offset, char* data, std::size_t size) const override;
+    const char* data() const override { return mData; }
+    bool willNeed(std::uint64_t offset, std::uint64_t size) const override;
+
+  private:
+    const char* mData{nullptr};
+    std::size_t mSize{0};
+#ifdef _WIN32
+    std::vector<char> mOwned;
+#endif
+  };
+
+  // size bytes of another source starting at offset, like an archive stored inside a container or another archive
+  // keeps the parent alive, a range of a range points straight at the parent's parent
+  class RangeSource : public Source {
+  public:
+    // an empty range if offset and size don't fit into the parent
+    RangeSource(std::shared_ptr<const Source> parent, std::uint64_t offset, std::uint64_t size);
+
+    std::uint64_t size() const override { return mSize; }
+    bool read(std::uint64_t offset, char* data, std::size_t size) const override;
+    const char* data() const override;
+    bool willNeed(std::uint64_t offset, std::uint64_t size) const override;
+
+  private:
+    std::shared_ptr<const Source> mParent;
+    std::uint64_t mOffset{0};
+    std::uint64_t mSize{0};
+  };
+}  // namespace fdb
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace fdb {
+#pragma pack(push, 4)
+  struct AccessRecord {
+    std::uint64_t time;  // microseconds since the trace was started
+    std::uint32_t index;
+    std::uint32_t bytes;  // payload bytes read, 0 for info()
+  };
+#pragma pack(pop)
+
+  // accesses of a Reader in the order they happened, see Reader::startTrace()
+  class AccessTrace {
+  public:
+    void add(std::uint32_t index, std::uint64_t time, std::uint32_t bytes) { mRecords.push_back({time, index, bytes}); }
+    void clear() { mRecords.clear(); }
+
+    [[nodiscard]] const std::vector<AccessRecord>& records() const noexcept { return mRecords; }
+    [[nodiscard]] bool empty() const noexcept { return mRecords.empty(); }
+    [[nodiscard]] std::size_t size() const noexcept { return mRecords.size(); }
+
+    bool save(const char* file) const;
+    bool load(const char* file);
+
+  private:
+    std::vector<AccessRecord> mRecords;
+  };
+
+  struct PrefetchOptions {
+    std::uint32_t window{64};                      // traced accesses kept in flight ahead of the reader
+    std::uint64_t windowBytes{64 * 1024 * 1024};   // and the most bytes they may add up to
+    bool read{false};  // read into the page cache instead of only advising the kernel
+  };
+}  // namespace fdb
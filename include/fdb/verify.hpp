@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fdb {
+  struct VerifyOptions {
+    unsigned threads{0};     // 0 = one per hardware thread
+    bool decompress{true};   // run the codecs and check the produced size
+  };
+
+  struct VerifyReport {
+    enum class Problem : std::uint32_t {
+      open,        // not a readable archive
+      header,      // entry header outside of the limits Reader::get() accepts
+      range,       // entry reaches past the end of the file
+      overlap,     // entry shares bytes with another entry or the table
+      decompress,  // codec failed
+      size,        // codec succeeded but produced the wrong amount of data
+      unsupported  // no codec available, entry was only checked structurally
+    };
+    struct Issue {
+      int index;  // -1 for the archive itself
+      Problem problem;
+      std::string message;
+    };
+
+    std::uint32_t entries{0};
+    std::uint32_t empty{0};
+    std::uint32_t decompressed{0};
+    std::uint64_t fileSize{0};
+    std::uint64_t compressedBytes{0};  // payload bytes as stored
+    std::uint64_t uncompressedBytes{0};
+    double seconds{0};
+    std::vector<Issue> issues;  // sorted by index
+
+    // unsupported codecs are not treated as damage
+    [[nodiscard]] bool ok() const;
+  };
+
+  const char* toString(VerifyReport::Problem problem);
+  // checks every entry of an archive, decompressing into a discarding sink
+  VerifyReport verify(const char* file, const VerifyOptions& options = {});
+}  // namespace fdb
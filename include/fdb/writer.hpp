@@ -0,0 +1,57 @@
+#pragma once
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "NormalFile.hpp"
+#include "base.hpp"
+
+namespace fdb {
+  class Writer {
+  public:
+    Writer() = default;
+    // reserve is the number of bytes kept free at the start of the file for the header and file table,
+    // if the table doesn't fit into it close() has to move all entries
+    explicit Writer(const char* file, std::uint64_t reserve = 0, Format format = Format::classic) {
+      open(file, reserve, format);
+    }
+    ~Writer() { close(); }
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    // classic archives are limited to 4 GB, extended ones are only readable by this library
+    bool open(const char* file, std::uint64_t reserve = 0, Format format = Format::classic);
+    // writes the file table, the archive is only readable after this
+    bool close();
+
+    [[nodiscard]] operator bool() const { return mPackage.is_open(); }
+
+    // payloads are written as they are, compress() them first if needed, zstd and lz4 need an extended archive
+    // index -1 appends to the table, otherwise the table grows to fit and unused slots stay empty
+    // an empty file becomes an entry without payload, like addEmpty()
+    bool add(const NormalFile& file, int index = -1);
+    // under another name, like the one stored in the archive file came from
+    bool add(const NormalFile& file, const std::string& name, int index = -1);
+    // table entry without payload (offset 0)
+    bool addEmpty(const std::string& name, FileType type, std::uint64_t time, int index = -1);
+
+    [[nodiscard]] std::uint32_t size() const noexcept { return static_cast<std::uint32_t>(mFileTable.size()); }
+    [[nodiscard]] Format format() const noexcept { return mFormat; }
+    // bytes of header and file table for count entries, nameBytes includes the terminators
+    [[nodiscard]] static std::uint64_t tableSize(std::uint32_t count, std::uint64_t nameBytes,
+                                                 Format format = Format::classic);
+
+  private:
+    bool slot(int index, const std::string& name);
+    bool relocate(std::uint64_t tablesize);
+
+  private:
+    std::ofstream mPackage;
+    std::string mPath;
+    Format mFormat{Format::classic};
+    std::uint64_t mReserve{0};
+    std::uint64_t mEnd{0};
+    std::vector<FileTableEntry> mFileTable;
+    std::vector<std::string> mFileNames;
+  };
+}  // namespace fdb
@@ -1,207 +1,33 @@
 #include "ImageFile.hpp"
-#include <filesystem>
+#include <atomic>
 #include <cstdint>
-#include <exception>
+#include <cstring>
 #include <fstream>
+#include <stdexcept>
 
+#include "convert.hpp"
 #include "impl/base.hpp"
+#include "impl/image.hpp"
 
-#define NOMINMAX
-#include <windows.h>
-
-// redux compression based on FDBExtractor by McBen
 namespace {
-  struct DLLWrapper {
-    template <typename Signature>
-    Signature get(const char* name) {
-      return (Signature)GetProcAddress(mDLL, name);
-    }
-    DLLWrapper() = default;
-    explicit DLLWrapper(const char* file) { load(file); }
-    bool load(const char* file) {
-      release();
-      mDLL = LoadLibraryA(file);
-      return mDLL != nullptr;
-    }
-    void release() {
-      if (mDLL) {
-        FreeLibrary(mDLL);
-      }
-    }
-    ~DLLWrapper() { release(); }
-    operator bool() const { return mDLL != nullptr; }
-
-    HMODULE mDLL;
-  };
-
-  DLLWrapper gReduxDll;
-  DLLWrapper gNVTTDll;
-}  // namespace
-namespace redux {
-#pragma pack(push, 4)
-  struct DATA2 {
-    void* new_data;
-    std::uint32_t unk;         // u2a
-    std::uint16_t width;       // u2b
-    std::uint16_t height;      // u2b
-    std::uint8_t mipmapcount;  // u2c
-    std::uint8_t pixelformat;
-    std::uint16_t padding;  // 16 bytes padding?
-  };
-  struct DATA {
-    DATA2 data;
-    std::uint8_t* imageData;  // pointer containing image data
-    std::uint8_t* unk;        // probably a pointer...
-    std::uint8_t* tempData;   // temporary Pointer?
-
-    std::uint32_t imageSize;  // sizeof imageData
-    std::uint32_t page_size;
-    std::uint32_t total_size;
-
-    const char* filename;
-    bool has_data;
-  };
-#pragma pack(pop)
-  constexpr std::uint32_t TopBit(std::uint32_t size) {
-    std::uint32_t power = (size > 0) ? 1 : 0;
-    while (power < size) power *= 2;
-    return power;
+  constexpr std::uint32_t fourcc(char a, char b, char c, char d) {
+    return std::uint32_t(std::uint8_t(a)) | (std::uint32_t(std::uint8_t(b)) << 8) |
+           (std::uint32_t(std::uint8_t(c)) << 16) | (std::uint32_t(std::uint8_t(d)) << 24);
   }
-  constexpr std::uint32_t getImageSize(std::int32_t format, std::int32_t mipmapcount, std::int32_t width,
-                                       std::int32_t height) {
-    int imagesize = 0;
-    mipmapcount = std::max(1, mipmapcount);
-    for (auto i = 0; i < mipmapcount; ++i, width >>= 1, height >>= 1) {
-      switch (format) {
-        case 1:
-        case 2:
-          imagesize += 2 * std::max(width, 1) * std::max(height, 1);
-          break;
-        case 3:
-          imagesize += 3 * std::max(width, 1) * std::max(height, 1);
-          break;
-        case 4:
-          imagesize += 4 * std::max(width, 1) * std::max(height, 1);
-          break;
-        case 5:
-        case 6:  // DDS
-          imagesize += std::max(width, 4) * std::max(height, 4) / 2;
-          break;
-        case 7:
-        case 8:
-          imagesize += std::max(width, 4) * std::max(height, 4);
-          break;
-      }
-    }
-    return imagesize;
-  }
-  constexpr std::uint8_t getPixelFormat(const DATA2& data) {
-    switch (data.pixelformat) {
-      case 0:
-      case 4:
-        return 4;
-      case 1:
-        return 5;
-      case 8:
-        return 3;
-      case 9:
-        return 7;
-      case 16:
-      case 20:
-        return 2;
-      case 17:
-        return 8;
-      case 21:
-        return 6;
-      case 24:
-        return 1;
-    }
-    return 0;
-  }
-
-  struct redux_status {
-    uint32_t k1;
-    uint32_t k2;
-    uint32_t k3;
-    size_t size;
-  };
-
-  using t_HandleDecompress = int (*)(char* data, int src_size, DATA* dst);
-  using t_CallbackSet = int (*)(unsigned nr, void* fct);
-  using t_HandleGetOutputDesc = int (*)(int a1, int a2, void* a3);
-
-  t_HandleDecompress handleDecompress{nullptr};
-  t_CallbackSet callbackSet{nullptr};
-  t_HandleGetOutputDesc handleGetOutputDesc{nullptr};
 
-  void* __stdcall CallbackBuffer(std::int32_t a1, DATA** _data, std::int32_t index, std::int32_t mipmaplevel,
-                                 redux_status* status) {
-    // void* __stdcall redux_callback2(int a1, a1_struct* a2, int a3, int a4, redux_status* a5)
-    auto data = *_data;
-    data->has_data = true;
-    if (mipmaplevel == 0) {
-      DATA2 inner;
-      handleGetOutputDesc(a1, index, &inner);
-      inner.width = TopBit(inner.width);
-      inner.height = TopBit(inner.height);
+  std::shared_ptr<const fdb::ImageFile::Decoder> gDecoder;
 
-      data->data = inner;
-      data->imageSize = getImageSize(getPixelFormat(inner), inner.mipmapcount, inner.width, inner.height);
-      data->imageData = nullptr;
-      data->tempData = nullptr;
-      data->total_size = 0;
-      if (data->imageSize > 0) {
-        data->imageData = new std::uint8_t[data->imageSize];
-      } else {
-        data->tempData = new std::uint8_t[status->size];
-      }
-    } else {
-      data->total_size += data->page_size;
-      if (!data->tempData && data->total_size >= data->imageSize && data->page_size > 0) {
-        data->tempData = new std::uint8_t[data->page_size];
-      }
-    }
-    data->page_size = status->size;
-    if (data->tempData) {
-      return data->tempData;
-    }
-    return data->imageData + data->total_size;
-  }
-  void __stdcall CallbackOnComplete(std::int32_t, DATA** _data, std::int32_t) {
-    // void* __stdcall redux_callback1(int a1, a1_struct* a2, int a3)
-    auto data = *_data;
-    data->has_data = true;
-    if (data->tempData) {
-      delete[] data->tempData;
-      data->tempData = nullptr;
-    }
-  }
-
-  // "redux_runtime.dll"
-  bool decompress(std::vector<char>& data, fdb::ImageFile* img) {
-    if (!gReduxDll) {
-      return false;
-    }
-    redux::DATA reduxData;
-    memset(&reduxData, 0, sizeof(reduxData));
-    reduxData.filename = "dummy";  // img->name().c_str();
-    auto res = redux::handleDecompress(&data.front(), data.size(), &reduxData);
-    if (res != 0 || reduxData.imageSize == 0) {
-      return false;
+  class StoredDecoder : public fdb::ImageFile::Decoder {
+  public:
+    bool decode(Context*, const std::vector<char>& in, fdb::ImageFile::Header& hdr,
+                std::vector<char>& out) const override {
+      const auto size = fdb::impl::imageSize(hdr.type, hdr.mipmap, hdr.width, hdr.height);
+      if (size == 0 || in.size() < size) return false;
+      out = in;
+      return true;
     }
-    data.resize(reduxData.imageSize);
-    memcpy(&data.front(), reduxData.imageData, data.size());
-
-    auto& hdr = img->getHeader();
-    hdr.height = reduxData.data.height;
-    hdr.width = reduxData.data.width;
-    hdr.mipmap = reduxData.data.mipmapcount;
-    hdr.type = redux::getPixelFormat(reduxData.data);
-
-    delete[] reduxData.imageData;
-    return true;
-  }
-}  // namespace redux
+  };
+}  // namespace
 namespace dds {
   constexpr std::uint32_t FOURCC = 0x00000004;  // DDPF_FOURCC
   constexpr std::uint32_t RGB = 0x00000040;     // DDPF_RGB
@@ -217,11 +43,11 @@ namespace dds {
       uint32_t dwBBitMask;
       uint32_t dwABitMask;
     };
-    constexpr Pf DXT1 = {sizeof(Pf), FOURCC, MAKEFOURCC('D', 'X', 'T', '1'), 0, 0, 0, 0, 0};
-    constexpr Pf DXT2 = {sizeof(Pf), FOURCC, MAKEFOURCC('D', 'X', 'T', '2'), 0, 0, 0, 0, 0};
-    constexpr Pf DXT3 = {sizeof(Pf), FOURCC, MAKEFOURCC('D', 'X', 'T', '3'), 0, 0, 0, 0, 0};
-    constexpr Pf DXT4 = {sizeof(Pf), FOURCC, MAKEFOURCC('D', 'X', 'T', '4'), 0, 0, 0, 0, 0};
-    constexpr Pf DXT5 = {sizeof(Pf), FOURCC, MAKEFOURCC('D', 'X', 'T', '5'), 0, 0, 0, 0, 0};
+    constexpr Pf DXT1 = {sizeof(Pf), FOURCC, fourcc('D', 'X', 'T', '1'), 0, 0, 0, 0, 0};
+    constexpr Pf DXT2 = {sizeof(Pf), FOURCC, fourcc('D', 'X', 'T', '2'), 0, 0, 0, 0, 0};
+    constexpr Pf DXT3 = {sizeof(Pf), FOURCC, fourcc('D', 'X', 'T', '3'), 0, 0, 0, 0, 0};
+    constexpr Pf DXT4 = {sizeof(Pf), FOURCC, fourcc('D', 'X', 'T', '4'), 0, 0, 0, 0, 0};
+    constexpr Pf DXT5 = {sizeof(Pf), FOURCC, fourcc('D', 'X', 'T', '5'), 0, 0, 0, 0, 0};
     constexpr Pf A8R8G8B8 = {sizeof(Pf), RGBA, 0, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000};
     constexpr Pf A1R5G5B5 = {sizeof(Pf), RGBA, 0, 16, 0x00007c00, 0x000003e0, 0x0000001f, 0x00008000};
     constexpr Pf A4R4G4B4 = {sizeof(Pf), RGBA, 0, 16, 0x00000f00, 0x000000f0, 0x0000000f, 0x0000f000};
@@ -345,6 +171,8 @@ namespace helper {
     }
   };
   struct DDS {
+    // pixel formats with a dds header, the 16 and 24 bit ones are converted first
+    static bool supported(std::uint32_t type) { return type >= 4 && type <= 8; }
     DDS(const fdb::ImageFile::Header& hdr) {
       header.dwHeight = hdr.height;
       header.dwWidth = hdr.width;
@@ -362,12 +190,12 @@ namespace helper {
           header.ddpf = dds::pf::DXT1;
           header.ddpf.dwFlags |= 1;
           break;  // + Alpha
+        case 7:
+          header.ddpf = dds::pf::DXT3;
+          break;
         case 8:
           header.ddpf = dds::pf::DXT5;
           break;
-
-        default:
-          throw;
       }
 
       if (hdr.mipmap > 1) {
@@ -387,44 +215,104 @@ namespace helper {
 }  // namespace helper
 
 namespace fdb {
-  bool initRedux(const char* path) {
-    if (gReduxDll) return gReduxDll;
-    if (path!=nullptr) {
-      std::filesystem::path p(path);
-      if (gNVTTDll.load((p / "redux_nvtt.dll").string().c_str())) {
-        gReduxDll.load((p / "redux_runtime.dll").string().c_str());
-      }
-    } 
-    if (!gReduxDll) {
-      if (gNVTTDll.load( "redux_nvtt.dll")) {
-        gReduxDll.load("redux_runtime.dll");
-      }
+  void ImageFile::decoder(std::shared_ptr<const Decoder> decoder) { std::atomic_store(&gDecoder, std::move(decoder)); }
+  std::shared_ptr<const ImageFile::Decoder> ImageFile::decoder() { return std::atomic_load(&gDecoder); }
+  std::shared_ptr<const ImageFile::Decoder> storedDecoder() {
+    static const auto decoder = std::make_shared<StoredDecoder>();
+    return decoder;
+  }
+  bool ImageFile::decompress() {
+    if (mCompression != Compression::redux) {
+      return NormalFile::decompress();
     }
-    if (!gReduxDll) {
-      gNVTTDll.release();
-      return false;
+    auto current = decoder();
+    if (!current) return false;
+    // the context stays with the thread, the decoder is pinned as long as its context lives
+    thread_local std::shared_ptr<const Decoder> owner;
+    thread_local std::unique_ptr<Decoder::Context> ctx;
+    if (owner != current) {
+      ctx = current->context();
+      owner = current;
     }
-    redux::handleDecompress = gReduxDll.get<redux::t_HandleDecompress>("reduxHandleDecompress");
-    redux::callbackSet = gReduxDll.get<redux::t_CallbackSet>("reduxCallbackSet");
-    redux::handleGetOutputDesc = gReduxDll.get<redux::t_HandleGetOutputDesc>("reduxHandleGetOutputDesc");
-    if (!redux::handleDecompress || !redux::callbackSet || !redux::handleGetOutputDesc) {
-      gReduxDll.release();
-      gNVTTDll.release();
-      return false;
+    return decompress(*current, ctx.get());
+  }
+  bool ImageFile::decompress(const Decoder& decoder, Decoder::Context* ctx) {
+    if (mCompression != Compression::redux) {
+      return NormalFile::decompress();
     }
-    redux::callbackSet(7, (void*)&redux::CallbackOnComplete);
-    redux::callbackSet(6, (void*)&redux::CallbackBuffer);
+    std::vector<char> out;
+    auto hdr = mHeader;
+    if (!decoder.decode(ctx, mData, hdr, out)) return false;
+    mHeader = hdr;
+    mData = std::move(out);
+    mSize = mData.size();
+    mCompression = Compression::none;
     return true;
-  };
-  bool ImageFile::decompress() {
-    if (mCompression == Compression::redux) {
-      if (!redux::decompress(mData, this)) return false;
-      mCompression = Compression::none;
-      return true;
+  }
+  std::uint32_t ImageFile::faces() const {
+    if (mCompression != Compression::none) return 0;
+    auto facesize = impl::imageSize(mHeader.type, mHeader.mipmap, mHeader.width, mHeader.height);
+    if (facesize == 0) return 0;
+    // cubemaps store all faces back to back, each with its full mipmap chain
+    return static_cast<std::uint32_t>(mData.size() / facesize);
+  }
+  ImageFile::Level ImageFile::level(std::uint32_t mipmap, std::uint32_t face) const {
+    Level res{face, mipmap, 0, 0, 0, 0, 0, nullptr};
+    if (mipmap >= std::max<std::uint32_t>(1, mHeader.mipmap) || face >= faces()) return res;
+    std::int32_t width = mHeader.width;
+    std::int32_t height = mHeader.height;
+    res.offset = face * static_cast<std::size_t>(impl::imageSize(mHeader.type, mHeader.mipmap, width, height));
+    for (std::uint32_t i = 0; i < mipmap; ++i, width >>= 1, height >>= 1) {
+      res.offset += impl::levelSize(mHeader.type, width, height);
     }
-    return NormalFile::decompress();
+    res.width = std::max(width, 1);
+    res.height = std::max(height, 1);
+    res.pitch = impl::levelPitch(mHeader.type, width);
+    res.size = impl::levelSize(mHeader.type, width, height);
+    res.data = mData.data() + res.offset;
+    return res;
   }
-  bool ImageFile::fromFile(const char*, const char* name) { throw std::exception("not implemented..."); }
+  std::vector<ImageFile::Level> ImageFile::levels() const {
+    std::vector<Level> res;
+    const std::uint32_t count = faces();
+    const std::uint32_t mipmaps = std::max<std::uint32_t>(1, mHeader.mipmap);
+    res.reserve(count * mipmaps);
+    std::size_t offset = 0;
+    for (std::uint32_t face = 0; face < count; ++face) {
+      std::int32_t width = mHeader.width;
+      std::int32_t height = mHeader.height;
+      for (std::uint32_t i = 0; i < mipmaps; ++i, width >>= 1, height >>= 1) {
+        Level l{face, i, static_cast<std::uint32_t>(std::max(width, 1)), static_cast<std::uint32_t>(std::max(height, 1)),
+                impl::levelPitch(mHeader.type, width), offset, impl::levelSize(mHeader.type, width, height), nullptr};
+        l.data = mData.data() + offset;
+        offset += l.size;
+        res.push_back(l);
+      }
+    }
+    return res;
+  }
+  bool ImageFile::convert() {
+    if (mCompression != Compression::none) return false;
+    if (mHeader.type == 4) return true;
+    const auto format = pixelFormat(mHeader.type);
+    if (format == PixelFormat::unk) return false;
+    const auto all = levels();
+    if (all.empty()) return false;
+    std::size_t total = 0;
+    for (const auto& l : all) total += std::size_t(l.width) * l.height * 4;
+    std::vector<char> res;
+    res.reserve(total);
+    std::vector<char> tmp;
+    for (const auto& l : all) {
+      if (!fdb::convert(format, l.data, l.size, l.width, l.height, PixelFormat::bgra8, tmp)) return false;
+      res.insert(res.end(), tmp.begin(), tmp.end());
+    }
+    mData = std::move(res);
+    mSize = mData.size();
+    mHeader.type = 4;
+    return true;
+  }
+  bool ImageFile::fromFile(const char*, const char* name) { throw std::runtime_error("not implemented..."); }
   bool ImageFile::toFile(const char* filename, bool _decompress) {
     if (_decompress) {
       decompress();
@@ -432,21 +320,29 @@ namespace fdb {
     if (mCompression != Compression::none) {
       return false;
     }
+    const bool isTga = mName.rfind(".tga") == mName.size() - 4;
+    const bool isDds = mName.rfind(".dds") == mName.size() - 4;
+    // tga is written as 32 bit, dds has no header for the 16/24 bit formats
+    if ((isTga && mHeader.type != 4) || (isDds && mHeader.type >= 1 && mHeader.type <= 3)) {
+      if (!convert()) return false;
+    }
+    if (isDds && !helper::DDS::supported(mHeader.type)) return false;
     std::ofstream file(filename, std::ios::binary);
     if (!file.is_open()) {
       return false;
     }
-    if (mName.rfind(".tga") == mName.size() - 4) {
+    if (isTga) {
       helper::TGA hdr(mHeader);
       file.write((char*)&hdr, sizeof(hdr));
     } else if (mName.rfind(".bmp") == mName.size() - 4) {
       helper::BMP hdr(mHeader);
       file.write((char*)&hdr, sizeof(hdr));
-    } else if (mName.rfind(".dds") == mName.size() - 4) {
+    } else if (isDds) {
       helper::DDS hdr(mHeader);
       file.write((char*)&hdr, sizeof(hdr));
     }
-    file.write(&mData.front(), mData.size());
-    return true;
+    if (!mData.empty()) file.write(mData.data(), mData.size());
+    file.close();
+    return !file.fail();
   }
 }  // namespace fdb
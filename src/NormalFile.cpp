@@ -1,8 +1,12 @@
 #include "NormalFile.hpp"
 
+#include <algorithm>
 #include <fstream>
+#include <limits>
 
+#include "codec.hpp"
 #include "impl/base.hpp"
+#include "impl/block.hpp"
 #include "zlib.h"
 
 namespace {
@@ -17,8 +21,16 @@ namespace {
     z_stream strm;
     strm.zalloc = 0;
     strm.zfree = 0;
-    strm.avail_in = data.size();
+    strm.opaque = 0;
+    // avail_in is 32 bit, entries of the extended format can be bigger
+    std::size_t left = data.size();
+    auto refill = [&] {
+      const auto n = std::min<std::size_t>(left, std::numeric_limits<uInt>::max());
+      strm.avail_in = static_cast<uInt>(n);
+      left -= n;
+    };
     strm.next_in = (Bytef*)&data.front();
+    refill();
     if (inflateInit(&strm) != Z_OK) return false;
 
     /* decompress until deflate stream ends or end of file */
@@ -38,13 +50,14 @@ namespace {
           return false;
       }
       buffer.insert(buffer.end(), temp_buffer, temp_buffer + BUFSIZE - strm.avail_out);
-      if (strm.avail_out != 0) break;
       if (ret == Z_STREAM_END) break;
+      if (strm.avail_in == 0) refill();
+      if (strm.avail_out != 0 && strm.avail_in == 0) break;
     };
 
     /* clean up and return */
     inflateEnd(&strm);
-    if (strm.avail_in == 0) {
+    if (strm.avail_in == 0 && left == 0) {
       buffer.swap(data);
       return true;
     }
@@ -60,22 +73,29 @@ namespace {
     z_stream strm;
     strm.zalloc = 0;
     strm.zfree = 0;
-    strm.avail_in = data.size();
+    strm.opaque = 0;
+    std::size_t left = data.size();
     strm.next_in = (uint8_t*)&data.front();
+    strm.avail_in = 0;
     if (deflateInit(&strm, Z_BEST_COMPRESSION) != Z_OK) return false;
     /* run deflate() on input until output buffer not full, finish
        compression if all of source has been read in */
     int ret;
     do {
+      if (strm.avail_in == 0 && left > 0) {
+        const auto n = std::min<std::size_t>(left, std::numeric_limits<uInt>::max());
+        strm.avail_in = static_cast<uInt>(n);
+        left -= n;
+      }
       strm.avail_out = BUFSIZE;
       strm.next_out = temp_buffer;
-      ret = deflate(&strm, strm.avail_in == 0 ? Z_FINISH : Z_NO_FLUSH); /* no bad return value */
-      if (ret == Z_STREAM_ERROR) {                                      /* state not clobbered */
+      ret = deflate(&strm, left ? Z_NO_FLUSH : Z_FINISH); /* no bad return value */
+      if (ret == Z_STREAM_ERROR) {    /* state not clobbered */
         deflateEnd(&strm);
         return false;
       }
       buffer.insert(buffer.end(), temp_buffer, temp_buffer + BUFSIZE - strm.avail_out);
-    } while (strm.avail_out == 0);
+    } while (strm.avail_out == 0 || left > 0);
 
     if (strm.avail_in != 0 || ret != Z_STREAM_END) { /* all input will be used  && stream will be complete */
       deflateEnd(&strm);
@@ -104,12 +124,20 @@ namespace fdb {
       case Compression::redux:
         // only for image files...
         return false;
+      case Compression::zstd:
+      case Compression::lz4: {
+        std::vector<char> out;
+        if (!impl::decompressBlocks(mCompression, mData.data(), mData.size(), mSize, out)) return false;
+        mData.swap(out);
+        mCompression = Compression::none;
+        return true;
+      }
     }
     return false;
   }
   bool NormalFile::compress(Compression compression) {
     if (!decompress()) return false;
-    switch (mCompression) {
+    switch (compression) {
       case Compression::none:
         return true;
       case Compression::rle:
@@ -119,11 +147,21 @@ namespace fdb {
       case Compression::zlib:
         if (compress_zlib(mData)) {
           mCompression = Compression::zlib;
+          mCompressedSize = mData.size();
           return true;
         }
         break;
       case Compression::redux:
         return false;
+      case Compression::zstd:
+      case Compression::lz4: {
+        std::vector<char> out;
+        if (!impl::compressBlocks(compression, mData.data(), mData.size(), out)) return false;
+        mData.swap(out);
+        mCompression = compression;
+        mCompressedSize = mData.size();
+        return true;
+      }
     }
     return false;
   }
@@ -135,7 +173,7 @@ namespace fdb {
     mCompressedSize = 0;
     mTime = 0;
     f.seekg(0, std::ios::end);
-    mSize = static_cast<std::uint32_t>(f.tellg());
+    mSize = static_cast<std::uint64_t>(f.tellg());
     f.seekg(0, std::ios::beg);
     mData.resize(mSize);
     if (mSize == 0) return true;
@@ -151,8 +189,8 @@ namespace fdb {
     }
     std::ofstream f(filename, std::ios::binary);
     if (!f.is_open()) return false;
-    if (mData.size() == 0) return true;
-    f.write(&mData.front(), mData.size());
-    return true;
+    if (!mData.empty()) f.write(mData.data(), mData.size());
+    f.close();
+    return !f.fail();
   }
 }  // namespace fdb
\ No newline at end of file
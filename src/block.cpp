@@ -0,0 +1,262 @@
+#include "codec.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+#include "impl/block.hpp"
+
+#ifdef FDB_WITH_ZSTD
+#include <zstd.h>
+#endif
+#ifdef FDB_WITH_LZ4
+#include <lz4.h>
+#endif
+
+namespace {
+  using fdb::Compression;
+
+  // smaller entries are not worth starting threads for
+  constexpr std::size_t PARALLEL_MIN = 4 * 1024 * 1024;
+
+  std::size_t bound(Compression compression, [[maybe_unused]] std::size_t size) {
+    switch (compression) {
+#ifdef FDB_WITH_ZSTD
+      case Compression::zstd:
+        return ZSTD_compressBound(size);
+#endif
+#ifdef FDB_WITH_LZ4
+      case Compression::lz4:
+        return static_cast<std::size_t>(LZ4_compressBound(static_cast<int>(size)));
+#endif
+      default:
+        return 0;
+    }
+  }
+  // compressed size, 0 on failure
+  // the codec arguments are unused when built without either codec
+  std::size_t compressBlock(Compression compression, [[maybe_unused]] const char* src,
+                            [[maybe_unused]] std::size_t size, [[maybe_unused]] char* dst,
+                            [[maybe_unused]] std::size_t capacity) {
+    switch (compression) {
+#ifdef FDB_WITH_ZSTD
+      case Compression::zstd: {
+        const auto n = ZSTD_compress(dst, capacity, src, size, ZSTD_CLEVEL_DEFAULT);
+        return ZSTD_isError(n) ? 0 : n;
+      }
+#endif
+#ifdef FDB_WITH_LZ4
+      case Compression::lz4: {
+        const auto n = LZ4_compress_default(src, dst, static_cast<int>(size), static_cast<int>(capacity));
+        return n > 0 ? static_cast<std::size_t>(n) : 0;
+      }
+#endif
+      default:
+        return 0;
+    }
+  }
+
+  unsigned workers(unsigned threads, std::size_t size, std::uint32_t blocks) {
+    if (size < PARALLEL_MIN) return 1;
+    const unsigned count = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    return std::max(1u, std::min<unsigned>(count, blocks));
+  }
+  // fn(block) for every block on up to count threads, false as soon as one call fails
+  template <typename Fn>
+  bool parallel(std::uint32_t blocks, unsigned count, Fn&& fn) {
+    std::atomic<std::uint32_t> next{0};
+    std::atomic<bool> ok{true};
+    auto run = [&] {
+      for (auto block = next++; block < blocks && ok; block = next++) {
+        if (!fn(block)) ok = false;
+      }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < count; ++i) threads.emplace_back(run);
+    run();
+    for (auto& t : threads) t.join();
+    return ok;
+  }
+}  // namespace
+
+namespace fdb {
+  bool available(Compression compression) {
+    switch (compression) {
+      case Compression::none:
+      case Compression::zlib:
+        return true;
+      case Compression::zstd:
+#ifdef FDB_WITH_ZSTD
+        return true;
+#else
+        return false;
+#endif
+      case Compression::lz4:
+#ifdef FDB_WITH_LZ4
+        return true;
+#else
+        return false;
+#endif
+      default:
+        return false;
+    }
+  }
+
+  namespace impl {
+    bool BlockIndex::header(const BlockHeader& hdr, std::uint64_t expectedSize, std::uint64_t payloadSize) {
+      // the writer never uses bigger blocks, a damaged header must not size any buffer
+      if (hdr.blockSize == 0 || hdr.blockSize > BLOCK_SIZE || expectedSize == 0) return false;
+      if (hdr.count != (expectedSize + hdr.blockSize - 1) / hdr.blockSize) return false;
+      if (indexSize(hdr.count) > payloadSize) return false;
+      mBlockSize = hdr.blockSize;
+      mExpected = expectedSize;
+      mOffsets.assign(std::size_t(hdr.count) + 1, 0);
+      return true;
+    }
+    bool BlockIndex::sizes(const std::uint32_t* sizes, std::uint64_t payloadSize) {
+      std::uint64_t offset = indexSize(count());
+      for (std::uint32_t i = 0; i < count(); ++i) {
+        mOffsets[i] = offset;
+        offset += sizes[i];
+      }
+      mOffsets.back() = offset;
+      return offset == payloadSize;
+    }
+
+    bool compressBlocks(Compression compression, const char* data, std::size_t size, std::vector<char>& out,
+                        unsigned threads) {
+      if (!blockCompressed(compression) || !available(compression) || size == 0) return false;
+      const std::uint64_t count = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+      if (count > std::numeric_limits<std::uint32_t>::max()) return false;
+      const auto blocks = static_cast<std::uint32_t>(count);
+
+      // every block is compressed into its own buffer, they are packed behind the index afterwards
+      std::vector<std::vector<char>> compressed(blocks);
+      const bool ok = parallel(blocks, workers(threads, size, blocks), [&](std::uint32_t block) {
+        const auto start = std::size_t(block) * BLOCK_SIZE;
+        const auto n = std::min<std::size_t>(BLOCK_SIZE, size - start);
+        auto& buffer = compressed[block];
+        buffer.resize(bound(compression, n));
+        const auto packed = compressBlock(compression, data + start, n, buffer.data(), buffer.size());
+        buffer.resize(packed);
+        return packed > 0;
+      });
+      if (!ok) return false;
+
+      BlockHeader hdr{BLOCK_SIZE, blocks};
+      std::size_t total = BlockIndex::indexSize(blocks);
+      for (const auto& b : compressed) total += b.size();
+      out.resize(total);
+      char* p = out.data();
+      memcpy(p, &hdr, sizeof(hdr));
+      p += sizeof(hdr);
+      for (const auto& b : compressed) {
+        const auto n = static_cast<std::uint32_t>(b.size());
+        memcpy(p, &n, sizeof(n));
+        p += sizeof(n);
+      }
+      for (const auto& b : compressed) {
+        memcpy(p, b.data(), b.size());
+        p += b.size();
+      }
+      return true;
+    }
+
+    bool decompressBlocks(Compression compression, const char* payload, std::size_t size, std::uint64_t expectedSize,
+                          std::vector<char>& out, unsigned threads) {
+      if (!blockCompressed(compression) || !available(compression) || size < sizeof(BlockHeader)) return false;
+      BlockHeader hdr;
+      memcpy(&hdr, payload, sizeof(hdr));
+      BlockIndex index;
+      if (!index.header(hdr, expectedSize, size)) return false;
+      std::vector<std::uint32_t> sizes(hdr.count);
+      memcpy(sizes.data(), payload + sizeof(hdr), sizes.size() * sizeof(std::uint32_t));
+      if (!index.sizes(sizes.data(), size)) return false;
+
+      out.resize(static_cast<std::size_t>(expectedSize));
+      return parallel(index.count(), workers(threads, out.size(), index.count()), [&](std::uint32_t block) {
+        return decompressBlock(compression, payload + index.offset(block), index.compressedSize(block),
+                               out.data() + std::size_t(block) * index.blockSize(), index.size(block));
+      });
+    }
+
+    bool decompressBlock(Compression compression, [[maybe_unused]] const char* src,
+                         [[maybe_unused]] std::size_t srcSize, [[maybe_unused]] char* dst,
+                         [[maybe_unused]] std::size_t dstSize) {
+      switch (compression) {
+#ifdef FDB_WITH_ZSTD
+        case Compression::zstd: {
+          const auto n = ZSTD_decompress(dst, dstSize, src, srcSize);
+          return !ZSTD_isError(n) && n == dstSize;
+        }
+#endif
+#ifdef FDB_WITH_LZ4
+        case Compression::lz4:
+          return LZ4_decompress_safe(src, dst, static_cast<int>(srcSize), static_cast<int>(dstSize)) ==
+                 static_cast<int>(dstSize);
+#endif
+        default:
+          return false;
+      }
+    }
+
+    bool readIndex(const PayloadSource& read, std::uint64_t payloadSize, std::uint64_t expectedSize,
+                   BlockIndex& index) {
+      BlockHeader hdr;
+      if (payloadSize < sizeof(hdr) || !read(0, (char*)&hdr, sizeof(hdr))) return false;
+      if (!index.header(hdr, expectedSize, payloadSize)) return false;
+      std::vector<std::uint32_t> sizes(hdr.count);
+      if (!read(sizeof(hdr), (char*)sizes.data(), sizes.size() * sizeof(std::uint32_t))) return false;
+      return index.sizes(sizes.data(), payloadSize);
+    }
+
+    bool decompressRange(Compression compression, const PayloadSource& read, const BlockIndex& index,
+                         std::uint64_t offset, std::size_t length, char* out, unsigned threads) {
+      if (length == 0) return true;
+      const auto first = static_cast<std::uint32_t>(offset / index.blockSize());
+      const auto last = static_cast<std::uint32_t>((offset + length - 1) / index.blockSize());
+      if (last >= index.count()) return false;
+
+      // the blocks are next to each other, one read covers all of them
+      const auto start = index.offset(first);
+      std::vector<char> input(static_cast<std::size_t>(index.offset(last) + index.compressedSize(last) - start));
+      if (!read(start, input.data(), input.size())) return false;
+
+      const auto blocks = last - first + 1;
+      return parallel(blocks, workers(threads, length, blocks), [&](std::uint32_t i) {
+        const auto block = first + i;
+        const auto begin = std::uint64_t(block) * index.blockSize();
+        const auto size = index.size(block);
+        const char* src = input.data() + (index.offset(block) - start);
+        // blocks that are only partly wanted go through a temporary
+        const auto from = std::max(offset, begin);
+        const auto to = std::min<std::uint64_t>(offset + length, begin + size);
+        if (from == begin && to == begin + size) {
+          return decompressBlock(compression, src, index.compressedSize(block), out + (begin - offset), size);
+        }
+        std::vector<char> temp(size);
+        if (!decompressBlock(compression, src, index.compressedSize(block), temp.data(), size)) return false;
+        memcpy(out + (from - offset), temp.data() + (from - begin), static_cast<std::size_t>(to - from));
+        return true;
+      });
+    }
+
+    bool streamBlocks(Compression compression, const PayloadSource& read, const BlockIndex& index, std::size_t chunk,
+                      const std::function<bool(const char* data, std::size_t size)>& sink) {
+      if (chunk == 0) return false;
+      std::vector<char> input;
+      std::vector<char> output(index.blockSize());
+      for (std::uint32_t block = 0; block < index.count(); ++block) {
+        input.resize(index.compressedSize(block));
+        if (!read(index.offset(block), input.data(), input.size())) return false;
+        const auto size = index.size(block);
+        if (!decompressBlock(compression, input.data(), input.size(), output.data(), size)) return false;
+        for (std::size_t pos = 0; pos < size; pos += chunk) {
+          if (!sink(output.data() + pos, std::min<std::size_t>(chunk, size - pos))) return false;
+        }
+      }
+      return true;
+    }
+  }  // namespace impl
+}  // namespace fdb
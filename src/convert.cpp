@@ -0,0 +1,427 @@
+#include "convert.hpp"
+
+#include <cstring>
+
+#include "impl/image.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FDB_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+  using fdb::PixelFormat;
+
+  std::uint32_t storageType(PixelFormat format) {
+    switch (format) {
+      case PixelFormat::r5g6b5:
+      case PixelFormat::a4r4g4b4:
+      case PixelFormat::a1r5g5b5:
+        return 1;
+      case PixelFormat::r8g8b8:
+        return 3;
+      case PixelFormat::bgra8:
+      case PixelFormat::rgba8:
+        return 4;
+      case PixelFormat::dxt1:
+        return 5;
+      case PixelFormat::dxt3:
+        return 7;
+      case PixelFormat::dxt5:
+        return 8;
+      default:
+        return 0;
+    }
+  }
+
+  inline std::uint16_t load16(const std::uint8_t* p) { return static_cast<std::uint16_t>(p[0] | (p[1] << 8)); }
+
+  // channel layout of the packed 16 bit formats
+  template <PixelFormat F>
+  struct Packed16;
+  template <>
+  struct Packed16<PixelFormat::r5g6b5> {
+    static constexpr int R = 11, RBits = 5, G = 5, GBits = 6, B = 0, BBits = 5, A = 0, ABits = 0;
+  };
+  template <>
+  struct Packed16<PixelFormat::a4r4g4b4> {
+    static constexpr int R = 8, RBits = 4, G = 4, GBits = 4, B = 0, BBits = 4, A = 12, ABits = 4;
+  };
+  template <>
+  struct Packed16<PixelFormat::a1r5g5b5> {
+    static constexpr int R = 10, RBits = 5, G = 5, GBits = 5, B = 0, BBits = 5, A = 15, ABits = 1;
+  };
+
+  // byte positions of red and blue inside an output pixel
+  template <bool BGRA>
+  struct Target {
+    static constexpr int R = BGRA ? 16 : 0;
+    static constexpr int B = BGRA ? 0 : 16;
+  };
+
+  // widen an n bit channel to 8 bit by replicating the top bits
+  template <int Bits>
+  constexpr std::uint32_t expand(std::uint32_t v) {
+    if constexpr (Bits == 0) {
+      return 0xff;
+    } else if constexpr (Bits == 1) {
+      return v * 0xff;
+    } else {
+      return (v << (8 - Bits)) | (v >> (2 * Bits - 8));
+    }
+  }
+
+  template <PixelFormat F, bool BGRA>
+  inline std::uint32_t pixel16(std::uint32_t v) {
+    using P = Packed16<F>;
+    using T = Target<BGRA>;
+    const auto r = expand<P::RBits>((v >> P::R) & ((1u << P::RBits) - 1));
+    const auto g = expand<P::GBits>((v >> P::G) & ((1u << P::GBits) - 1));
+    const auto b = expand<P::BBits>((v >> P::B) & ((1u << P::BBits) - 1));
+    const auto a = expand<P::ABits>(P::ABits ? (v >> P::A) & ((1u << P::ABits) - 1) : 0);
+    return (r << T::R) | (g << 8) | (b << T::B) | (a << 24);
+  }
+
+#ifdef FDB_SSE2
+  template <int Bits>
+  inline __m128i expand(__m128i v) {
+    if constexpr (Bits == 0) {
+      return _mm_set1_epi32(0xff);
+    } else if constexpr (Bits == 1) {
+      return _mm_sub_epi32(_mm_slli_epi32(v, 8), v);
+    } else {
+      return _mm_or_si128(_mm_slli_epi32(v, 8 - Bits), _mm_srli_epi32(v, 2 * Bits - 8));
+    }
+  }
+  template <int Shift, int Bits>
+  inline __m128i channel(__m128i v) {
+    if constexpr (Bits == 0) {
+      return expand<0>(v);
+    } else {
+      return expand<Bits>(_mm_and_si128(_mm_srli_epi32(v, Shift), _mm_set1_epi32((1 << Bits) - 1)));
+    }
+  }
+  template <PixelFormat F, bool BGRA>
+  inline __m128i pixel16(__m128i v) {
+    using P = Packed16<F>;
+    using T = Target<BGRA>;
+    const auto r = _mm_slli_epi32(channel<P::R, P::RBits>(v), T::R);
+    const auto g = _mm_slli_epi32(channel<P::G, P::GBits>(v), 8);
+    const auto b = _mm_slli_epi32(channel<P::B, P::BBits>(v), T::B);
+    const auto a = _mm_slli_epi32(channel<P::A, P::ABits>(v), 24);
+    return _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, a));
+  }
+#endif
+
+  template <PixelFormat F, bool BGRA>
+  void convert16(const std::uint8_t* src, std::size_t count, std::uint32_t* dst) {
+    std::size_t i = 0;
+#ifdef FDB_SSE2
+    const auto zero = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8) {
+      const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), pixel16<F, BGRA>(_mm_unpacklo_epi16(v, zero)));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), pixel16<F, BGRA>(_mm_unpackhi_epi16(v, zero)));
+    }
+#endif
+    for (; i < count; ++i) {
+      dst[i] = pixel16<F, BGRA>(load16(src + i * 2));
+    }
+  }
+
+  // swaps red and blue, turns rgba8 into bgra8 and back
+  void swizzle(const std::uint8_t* src, std::size_t count, std::uint32_t* dst) {
+    std::size_t i = 0;
+#ifdef FDB_SSE2
+    const auto ga = _mm_set1_epi32(static_cast<int>(0xff00ff00));
+    const auto lo = _mm_set1_epi32(0xff);
+    for (; i + 4 <= count; i += 4) {
+      const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+      const auto r = _mm_or_si128(_mm_and_si128(v, ga), _mm_and_si128(_mm_srli_epi32(v, 16), lo));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                       _mm_or_si128(r, _mm_slli_epi32(_mm_and_si128(v, lo), 16)));
+    }
+#endif
+    for (; i < count; ++i) {
+      std::uint32_t v;
+      memcpy(&v, src + i * 4, sizeof(v));
+      dst[i] = (v & 0xff00ff00) | ((v >> 16) & 0xff) | ((v & 0xff) << 16);
+    }
+  }
+
+  template <bool BGRA>
+  void convert24(const std::uint8_t* src, std::size_t count, std::uint32_t* dst) {
+    using T = Target<BGRA>;
+    for (std::size_t i = 0; i < count; ++i, src += 3) {
+      dst[i] = (std::uint32_t(src[2]) << T::R) | (std::uint32_t(src[1]) << 8) | (std::uint32_t(src[0]) << T::B) |
+               0xff000000;
+    }
+  }
+
+  // DXT color block, builds the four palette entries once and looks them up per pixel
+  template <bool BGRA>
+  void colorPalette(const std::uint8_t* block, bool allowTransparent, std::uint32_t* palette) {
+    using T = Target<BGRA>;
+    const auto c0 = load16(block);
+    const auto c1 = load16(block + 2);
+    std::uint32_t r[4], g[4], b[4];
+    r[0] = expand<5>(c0 >> 11), g[0] = expand<6>((c0 >> 5) & 0x3f), b[0] = expand<5>(c0 & 0x1f);
+    r[1] = expand<5>(c1 >> 11), g[1] = expand<6>((c1 >> 5) & 0x3f), b[1] = expand<5>(c1 & 0x1f);
+    std::uint32_t a3 = 0xff;
+    if (c0 > c1 || !allowTransparent) {
+      r[2] = (2 * r[0] + r[1]) / 3, g[2] = (2 * g[0] + g[1]) / 3, b[2] = (2 * b[0] + b[1]) / 3;
+      r[3] = (r[0] + 2 * r[1]) / 3, g[3] = (g[0] + 2 * g[1]) / 3, b[3] = (b[0] + 2 * b[1]) / 3;
+    } else {
+      r[2] = (r[0] + r[1]) / 2, g[2] = (g[0] + g[1]) / 2, b[2] = (b[0] + b[1]) / 2;
+      r[3] = g[3] = b[3] = a3 = 0;
+    }
+    for (int i = 0; i < 4; ++i) {
+      palette[i] = (r[i] << T::R) | (g[i] << 8) | (b[i] << T::B) | 0xff000000;
+    }
+    palette[3] = (palette[3] & 0x00ffffff) | (a3 << 24);
+  }
+
+  void alphaPalette(const std::uint8_t* block, std::uint32_t* palette) {
+    const std::uint32_t a0 = block[0];
+    const std::uint32_t a1 = block[1];
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1) {
+      for (std::uint32_t i = 1; i < 7; ++i) palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+    } else {
+      for (std::uint32_t i = 1; i < 5; ++i) palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+      palette[6] = 0;
+      palette[7] = 0xff;
+    }
+  }
+
+  template <PixelFormat F, bool BGRA>
+  void decodeBlocks(const std::uint8_t* src, std::uint32_t width, std::uint32_t height, std::uint32_t* dst) {
+    constexpr std::size_t BlockSize = F == PixelFormat::dxt1 ? 8 : 16;
+    const std::uint32_t bw = fdb::impl::blockCount(static_cast<std::int32_t>(width));
+    const std::uint32_t bh = fdb::impl::blockCount(static_cast<std::int32_t>(height));
+    std::uint32_t palette[4];
+    std::uint32_t alpha[16];
+    for (std::uint32_t by = 0; by < bh; ++by) {
+      for (std::uint32_t bx = 0; bx < bw; ++bx, src += BlockSize) {
+        const std::uint8_t* color = BlockSize == 16 ? src + 8 : src;
+        colorPalette<BGRA>(color, F == PixelFormat::dxt1, palette);
+        std::uint32_t indices = color[4] | (color[5] << 8) | (color[6] << 16) | (std::uint32_t(color[7]) << 24);
+        if constexpr (F == PixelFormat::dxt3) {
+          for (int i = 0; i < 16; ++i) alpha[i] = ((src[i / 2] >> ((i & 1) * 4)) & 0xf) * 0x11;
+        } else if constexpr (F == PixelFormat::dxt5) {
+          std::uint32_t table[8];
+          alphaPalette(src, table);
+          std::uint64_t bits = 0;
+          for (int i = 0; i < 6; ++i) bits |= std::uint64_t(src[2 + i]) << (8 * i);
+          for (int i = 0; i < 16; ++i, bits >>= 3) alpha[i] = table[bits & 7];
+        }
+        const std::uint32_t rows = std::min<std::uint32_t>(4, height - by * 4);
+        const std::uint32_t cols = std::min<std::uint32_t>(4, width - bx * 4);
+        for (std::uint32_t y = 0; y < rows; ++y) {
+          auto* out = dst + (by * 4 + y) * std::size_t(width) + bx * 4;
+          for (std::uint32_t x = 0; x < cols; ++x) {
+            auto p = palette[(indices >> (2 * (y * 4 + x))) & 3];
+            if constexpr (F != PixelFormat::dxt1) {
+              p = (p & 0x00ffffff) | (alpha[y * 4 + x] << 24);
+            }
+            out[x] = p;
+          }
+        }
+      }
+    }
+  }
+
+  template <bool BGRA>
+  bool dispatch(PixelFormat from, const std::uint8_t* src, std::uint32_t width, std::uint32_t height,
+                std::uint32_t* dst) {
+    const std::size_t count = std::size_t(width) * height;
+    switch (from) {
+      case PixelFormat::r5g6b5:
+        convert16<PixelFormat::r5g6b5, BGRA>(src, count, dst);
+        return true;
+      case PixelFormat::a4r4g4b4:
+        convert16<PixelFormat::a4r4g4b4, BGRA>(src, count, dst);
+        return true;
+      case PixelFormat::a1r5g5b5:
+        convert16<PixelFormat::a1r5g5b5, BGRA>(src, count, dst);
+        return true;
+      case PixelFormat::r8g8b8:
+        convert24<BGRA>(src, count, dst);
+        return true;
+      case PixelFormat::bgra8:
+        if (BGRA) {
+          memcpy(dst, src, count * 4);
+        } else {
+          swizzle(src, count, dst);
+        }
+        return true;
+      case PixelFormat::rgba8:
+        if (BGRA) {
+          swizzle(src, count, dst);
+        } else {
+          memcpy(dst, src, count * 4);
+        }
+        return true;
+      case PixelFormat::dxt1:
+        decodeBlocks<PixelFormat::dxt1, BGRA>(src, width, height, dst);
+        return true;
+      case PixelFormat::dxt3:
+        decodeBlocks<PixelFormat::dxt3, BGRA>(src, width, height, dst);
+        return true;
+      case PixelFormat::dxt5:
+        decodeBlocks<PixelFormat::dxt5, BGRA>(src, width, height, dst);
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  bool prepare(PixelFormat from, std::size_t size, std::uint32_t width, std::uint32_t height, PixelFormat to,
+               std::vector<char>& dst) {
+    if (to != PixelFormat::rgba8 && to != PixelFormat::bgra8) return false;
+    const auto needed = fdb::levelSize(from, width, height);
+    if (needed == 0 || size < needed) return false;
+    dst.resize(std::size_t(width) * height * 4);
+    return true;
+  }
+}  // namespace
+
+namespace fdb {
+  PixelFormat pixelFormat(std::uint32_t type) {
+    switch (type) {
+      case 1:
+        return PixelFormat::r5g6b5;
+      case 2:
+        return PixelFormat::a4r4g4b4;
+      case 3:
+        return PixelFormat::r8g8b8;
+      case 4:
+        return PixelFormat::bgra8;
+      case 5:
+      case 6:
+        return PixelFormat::dxt1;
+      case 7:
+        return PixelFormat::dxt3;
+      case 8:
+        return PixelFormat::dxt5;
+    }
+    return PixelFormat::unk;
+  }
+  std::size_t levelSize(PixelFormat format, std::uint32_t width, std::uint32_t height) {
+    return impl::levelSize(storageType(format), width, height);
+  }
+  bool convert(PixelFormat from, const void* src, std::size_t size, std::uint32_t width, std::uint32_t height,
+               PixelFormat to, std::vector<char>& dst) {
+    if (!prepare(from, size, width, height, to, dst)) return false;
+    if (dst.empty()) return true;
+    auto* out = reinterpret_cast<std::uint32_t*>(dst.data());
+    auto* in = static_cast<const std::uint8_t*>(src);
+    return to == PixelFormat::bgra8 ? dispatch<true>(from, in, width, height, out)
+                                    : dispatch<false>(from, in, width, height, out);
+  }
+
+  namespace reference {
+    namespace {
+      struct Rgba {
+        std::uint32_t r, g, b, a;
+      };
+      std::uint32_t bits(std::uint32_t v, int shift, int count) {
+        const std::uint32_t c = (v >> shift) & ((1u << count) - 1);
+        return (c * 255 + ((1u << count) - 1) / 2) / ((1u << count) - 1);
+      }
+      Rgba rgb565(std::uint32_t v) {
+        // bit replication is what the fast path and most decoders use
+        const std::uint32_t r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+        return {(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 255};
+      }
+      Rgba pixel(PixelFormat from, const std::uint8_t* src, std::uint32_t width, std::uint32_t x, std::uint32_t y) {
+        const std::size_t i = std::size_t(y) * width + x;
+        switch (from) {
+          case PixelFormat::r5g6b5:
+            return rgb565(src[i * 2] | (src[i * 2 + 1] << 8));
+          case PixelFormat::a4r4g4b4: {
+            const std::uint32_t v = src[i * 2] | (src[i * 2 + 1] << 8);
+            return {bits(v, 8, 4), bits(v, 4, 4), bits(v, 0, 4), bits(v, 12, 4)};
+          }
+          case PixelFormat::a1r5g5b5: {
+            const std::uint32_t v = src[i * 2] | (src[i * 2 + 1] << 8);
+            const std::uint32_t r = (v >> 10) & 31, g = (v >> 5) & 31, b = v & 31;
+            return {(r << 3) | (r >> 2), (g << 3) | (g >> 2), (b << 3) | (b >> 2), (v >> 15) ? 255u : 0u};
+          }
+          case PixelFormat::r8g8b8:
+            return {src[i * 3 + 2], src[i * 3 + 1], src[i * 3], 255};
+          case PixelFormat::bgra8:
+            return {src[i * 4 + 2], src[i * 4 + 1], src[i * 4], src[i * 4 + 3]};
+          case PixelFormat::rgba8:
+            return {src[i * 4], src[i * 4 + 1], src[i * 4 + 2], src[i * 4 + 3]};
+          default:
+            break;
+        }
+        // block compressed
+        const std::uint32_t blockSize = from == PixelFormat::dxt1 ? 8 : 16;
+        const std::uint32_t blocksPerRow = impl::blockCount(static_cast<std::int32_t>(width));
+        const auto* block = src + (std::size_t(y / 4) * blocksPerRow + x / 4) * blockSize;
+        const std::uint32_t p = (y % 4) * 4 + x % 4;
+        const auto* color = blockSize == 16 ? block + 8 : block;
+        const std::uint32_t c0 = color[0] | (color[1] << 8);
+        const std::uint32_t c1 = color[2] | (color[3] << 8);
+        const std::uint32_t index = (color[4 + p / 4] >> ((p % 4) * 2)) & 3;
+        const auto e0 = rgb565(c0);
+        const auto e1 = rgb565(c1);
+        Rgba res{};
+        if (index == 0) {
+          res = e0;
+        } else if (index == 1) {
+          res = e1;
+        } else if (c0 > c1 || from != PixelFormat::dxt1) {
+          const std::uint32_t w0 = index == 2 ? 2 : 1, w1 = 3 - w0;
+          res = {(w0 * e0.r + w1 * e1.r) / 3, (w0 * e0.g + w1 * e1.g) / 3, (w0 * e0.b + w1 * e1.b) / 3, 255};
+        } else if (index == 2) {
+          res = {(e0.r + e1.r) / 2, (e0.g + e1.g) / 2, (e0.b + e1.b) / 2, 255};
+        } else {
+          res = {0, 0, 0, 0};
+        }
+        if (from == PixelFormat::dxt3) {
+          res.a = ((block[p / 2] >> ((p % 2) * 4)) & 0xf) * 17;
+        } else if (from == PixelFormat::dxt5) {
+          const std::uint32_t a0 = block[0], a1 = block[1];
+          const std::uint32_t bit = 16 + p * 3;
+          std::uint32_t code = 0;
+          for (std::uint32_t b = 0; b < 3; ++b) {
+            code |= ((block[(bit + b) / 8] >> ((bit + b) % 8)) & 1) << b;
+          }
+          if (code == 0) {
+            res.a = a0;
+          } else if (code == 1) {
+            res.a = a1;
+          } else if (a0 > a1) {
+            res.a = ((8 - code) * a0 + (code - 1) * a1) / 7;
+          } else if (code < 6) {
+            res.a = ((6 - code) * a0 + (code - 1) * a1) / 5;
+          } else {
+            res.a = code == 6 ? 0 : 255;
+          }
+        }
+        return res;
+      }
+    }  // namespace
+
+    bool convert(PixelFormat from, const void* src, std::size_t size, std::uint32_t width, std::uint32_t height,
+                 PixelFormat to, std::vector<char>& dst) {
+      if (!prepare(from, size, width, height, to, dst)) return false;
+      auto* in = static_cast<const std::uint8_t*>(src);
+      auto* out = reinterpret_cast<std::uint8_t*>(dst.data());
+      for (std::uint32_t y = 0; y < height; ++y) {
+        for (std::uint32_t x = 0; x < width; ++x, out += 4) {
+          const auto p = pixel(from, in, width, x, y);
+          out[0] = static_cast<std::uint8_t>(to == PixelFormat::bgra8 ? p.b : p.r);
+          out[1] = static_cast<std::uint8_t>(p.g);
+          out[2] = static_cast<std::uint8_t>(to == PixelFormat::bgra8 ? p.r : p.b);
+          out[3] = static_cast<std::uint8_t>(p.a);
+        }
+      }
+      return true;
+    }
+  }  // namespace reference
+}  // namespace fdb
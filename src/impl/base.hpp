@@ -4,11 +4,32 @@
 namespace fdb {
   namespace impl {
     constexpr std::uint32_t MAGIC = 0x46444201;
+    // extended format, same layout with 64 bit offsets and sizes
+    constexpr std::uint32_t MAGIC64 = 0x46444202;
+    constexpr std::uint32_t VERSION64 = 1;
 #pragma pack(push, 4)
     struct FDBHeader {
       std::uint32_t magic{MAGIC};
       std::uint32_t filecount;
     };
+    struct FDBHeader64 {
+      std::uint32_t magic{MAGIC64};
+      std::uint32_t version{VERSION64};
+      std::uint32_t filecount;
+      std::uint32_t reserved{0};
+    };
+    // file table entries as stored, the reader widens both to fdb::FileTableEntry
+    struct FileTableEntry32 {
+      FileType type;
+      std::uint64_t time;
+      std::uint32_t offset;
+    };
+    struct FileTableEntry64 {
+      FileType type;
+      std::uint32_t reserved;
+      std::uint64_t time;
+      std::uint64_t offset;
+    };
     struct NormalFileHeader {
       std::uint32_t size;
       FileType type;
@@ -18,6 +39,16 @@ namespace fdb {
       std::uint64_t time;
       std::uint32_t namelength;
     };
+    struct NormalFileHeader64 {
+      std::uint64_t size;
+      FileType type;
+      Compression compression;
+      std::uint64_t size_uncompressed;
+      std::uint64_t size_compressed;
+      std::uint64_t time;
+      std::uint32_t namelength;
+      std::uint32_t reserved;
+    };
     struct ImageFileHeader {
       std::uint32_t type;
       std::uint32_t width;
@@ -25,6 +56,50 @@ namespace fdb {
       std::uint8_t mipmap;
       std::uint8_t unk[3];
     };
-  }  // namespace impl
 #pragma pack(pop)
-}  // namespace fdb
\ No newline at end of file
+
+    // largest compressed payload of the classic format, codecs without streaming hold it in memory at once
+    constexpr std::uint64_t MAX_PACKED_SIZE = 0x10000000;
+
+    // sanity limits for a single entry, anything outside of them is a broken table or a damaged entry
+    inline bool valid(const NormalFileHeader& nfh) {
+      // if the file is bigger than 2GB than there is something horribly wrong
+      if (nfh.size_uncompressed >> 31) return false;
+      if (nfh.size_uncompressed == 0) return false;
+      if (nfh.size_compressed > MAX_PACKED_SIZE) return false;
+      if (nfh.namelength > 0x200) return false;
+      return true;
+    }
+    inline bool valid(const NormalFileHeader64& nfh) {
+      // 256 TB, more than any disk this runs on
+      if (nfh.size_uncompressed >> 48) return false;
+      if (nfh.size_uncompressed == 0) return false;
+      if (nfh.size_compressed >> 48) return false;
+      if (nfh.namelength > 0x200) return false;
+      return true;
+    }
+    inline NormalFileHeader64 widen(const NormalFileHeader& nfh) {
+      return {nfh.size, nfh.type, nfh.compression, nfh.size_uncompressed, nfh.size_compressed, nfh.time,
+              nfh.namelength, 0};
+    }
+    // bytes of the payload that follows the entry header, name and image header
+    inline std::uint64_t payloadSize(const NormalFileHeader64& nfh) {
+      return nfh.compression == Compression::none ? nfh.size_uncompressed : nfh.size_compressed;
+    }
+    inline std::uint32_t payloadSize(const NormalFileHeader& nfh) {
+      return nfh.compression == Compression::none ? nfh.size_uncompressed : nfh.size_compressed;
+    }
+    constexpr std::size_t headerSize(Format format) {
+      return format == Format::extended ? sizeof(NormalFileHeader64) : sizeof(NormalFileHeader);
+    }
+    // reads an entry header of either format through read(char*, size), checked and widened
+    template <typename Read>
+    bool readHeader(Read&& read, Format format, NormalFileHeader64& nfh) {
+      if (format == Format::extended) return read((char*)&nfh, sizeof(nfh)) && valid(nfh);
+      NormalFileHeader classic;
+      if (!read((char*)&classic, sizeof(classic)) || !valid(classic)) return false;
+      nfh = widen(classic);
+      return true;
+    }
+  }  // namespace impl
+}  // namespace fdb
@@ -0,0 +1,70 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "range.hpp"
+
+namespace fdb {
+  namespace impl {
+#pragma pack(push, 4)
+    // start of a block compressed payload, followed by the compressed size of every block and then the blocks
+    struct BlockHeader {
+      std::uint32_t blockSize;  // uncompressed bytes per block, the last one may be shorter
+      std::uint32_t count;
+    };
+#pragma pack(pop)
+
+    class BlockIndex {
+    public:
+      // bytes of header and sizes for count blocks
+      static std::size_t indexSize(std::uint32_t count) {
+        return sizeof(BlockHeader) + count * sizeof(std::uint32_t);
+      }
+
+      // checks the header against the entry before the sizes are read, payloadSize includes the index
+      bool header(const BlockHeader& hdr, std::uint64_t expectedSize, std::uint64_t payloadSize);
+      // sizes of all blocks, payloadSize is everything including the index
+      bool sizes(const std::uint32_t* sizes, std::uint64_t payloadSize);
+
+      std::uint32_t count() const { return static_cast<std::uint32_t>(mOffsets.size()) - 1; }
+      std::uint32_t blockSize() const { return mBlockSize; }
+      // offset of a block inside the payload and its compressed size
+      std::uint64_t offset(std::uint32_t block) const { return mOffsets[block]; }
+      std::uint32_t compressedSize(std::uint32_t block) const {
+        return static_cast<std::uint32_t>(mOffsets[block + 1] - mOffsets[block]);
+      }
+      // uncompressed size of a block
+      std::uint32_t size(std::uint32_t block) const {
+        const auto start = std::uint64_t(block) * mBlockSize;
+        return static_cast<std::uint32_t>(std::min<std::uint64_t>(mBlockSize, mExpected - start));
+      }
+
+    private:
+      std::uint32_t mBlockSize{0};
+      std::uint64_t mExpected{0};
+      std::vector<std::uint64_t> mOffsets;  // count + 1
+    };
+
+    // whole payloads, threads 0 = one per hardware thread
+    bool compressBlocks(Compression compression, const char* data, std::size_t size, std::vector<char>& out,
+                        unsigned threads = 0);
+    bool decompressBlocks(Compression compression, const char* payload, std::size_t size, std::uint64_t expectedSize,
+                          std::vector<char>& out, unsigned threads = 0);
+    // a single block, dstSize has to match exactly
+    bool decompressBlock(Compression compression, const char* src, std::size_t srcSize, char* dst,
+                         std::size_t dstSize);
+
+    // reads and checks the index at the start of a stored payload
+    bool readIndex(const PayloadSource& read, std::uint64_t payloadSize, std::uint64_t expectedSize,
+                   BlockIndex& index);
+    // decodes only the blocks overlapping length bytes at offset
+    bool decompressRange(Compression compression, const PayloadSource& read, const BlockIndex& index,
+                         std::uint64_t offset, std::size_t length, char* out, unsigned threads = 0);
+    // decodes one block after another, handing them to sink in pieces of at most chunk bytes
+    bool streamBlocks(Compression compression, const PayloadSource& read, const BlockIndex& index, std::size_t chunk,
+                      const std::function<bool(const char* data, std::size_t size)>& sink);
+  }  // namespace impl
+}  // namespace fdb
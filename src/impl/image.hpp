@@ -0,0 +1,60 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+
+namespace fdb {
+  namespace impl {
+    // pixel format rules for ImageFile::Header::type
+    // 1,2: 16 bit  3: 24 bit  4: 32 bit  5,6: DXT1  7,8: DXT3/DXT5
+    constexpr bool isBlockCompressed(std::uint32_t format) { return format >= 5 && format <= 8; }
+    // 4x4 blocks covering a row or column, a partial block at the end still takes a whole one
+    constexpr std::uint32_t blockCount(std::int32_t pixels) { return (std::max(pixels, 1) + 3) / 4; }
+
+    // bytes per row of pixels, or per row of 4x4 blocks for block compressed formats
+    constexpr std::uint32_t levelPitch(std::uint32_t format, std::int32_t width) {
+      switch (format) {
+        case 1:
+        case 2:
+          return 2 * std::max(width, 1);
+        case 3:
+          return 3 * std::max(width, 1);
+        case 4:
+          return 4 * std::max(width, 1);
+        case 5:
+        case 6:
+          return blockCount(width) * 8;
+        case 7:
+        case 8:
+          return blockCount(width) * 16;
+      }
+      return 0;
+    }
+    constexpr std::uint32_t levelSize(std::uint32_t format, std::int32_t width, std::int32_t height) {
+      switch (format) {
+        case 1:
+        case 2:
+          return 2 * std::max(width, 1) * std::max(height, 1);
+        case 3:
+          return 3 * std::max(width, 1) * std::max(height, 1);
+        case 4:
+          return 4 * std::max(width, 1) * std::max(height, 1);
+        case 5:
+        case 6:  // DDS
+          return blockCount(width) * blockCount(height) * 8;
+        case 7:
+        case 8:
+          return blockCount(width) * blockCount(height) * 16;
+      }
+      return 0;
+    }
+    constexpr std::uint32_t imageSize(std::uint32_t format, std::int32_t mipmapcount, std::int32_t width,
+                                      std::int32_t height) {
+      std::uint32_t imagesize = 0;
+      mipmapcount = std::max(1, mipmapcount);
+      for (auto i = 0; i < mipmapcount; ++i, width >>= 1, height >>= 1) {
+        imagesize += levelSize(format, width, height);
+      }
+      return imagesize;
+    }
+  }  // namespace impl
+}  // namespace fdb
@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "trace.hpp"
+
+namespace fdb {
+  class Source;
+  namespace impl {
+    // walks a recorded trace a window ahead of the live accesses and pulls those entries into the page cache
+    class Prefetcher {
+    public:
+      struct Target {
+        std::uint32_t index;
+        std::uint64_t offset;
+        bool image;
+      };
+      Prefetcher(std::shared_ptr<const Source> source, Format format, std::vector<Target> targets, const PrefetchOptions& options);
+      ~Prefetcher();
+      Prefetcher(const Prefetcher&) = delete;
+      Prefetcher& operator=(const Prefetcher&) = delete;
+
+      // called by the reader for every get()/info()
+      void accessed(std::uint32_t index);
+      std::uint64_t issued() const { return mIssued; }
+
+    private:
+      void run();
+      std::uint64_t fetch(const Target& target);
+
+    private:
+      const PrefetchOptions mOptions;
+      const Format mFormat;
+      std::shared_ptr<const Source> mSource;
+      std::vector<Target> mTargets;  // trace records that point to an entry
+      std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> mPositions;
+      std::vector<std::uint64_t> mBytes;  // fetched per trace position
+      std::vector<bool> mDone;            // per target index, every entry is fetched only once
+      std::vector<char> mScratch;
+
+      std::mutex mCriticalSection;
+      std::condition_variable mChanged;
+      std::int64_t mCursor{-1};  // last trace position the reader reached
+      std::size_t mNext{0};      // next trace position to fetch
+      std::uint64_t mAhead{0};   // bytes fetched past the cursor
+      bool mStop{false};
+      std::atomic<std::uint64_t> mIssued{0};
+      std::thread mThread;
+    };
+  }  // namespace impl
+}  // namespace fdb
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace fdb {
+  namespace impl {
+    // deflate can reference up to 32 KB back, resuming needs that much history
+    constexpr std::size_t WINDOW_SIZE = 32768;
+
+    // inflate state at a deflate block boundary
+    struct Checkpoint {
+      std::uint64_t out;  // decompressed bytes before it
+      std::uint64_t in;   // compressed bytes consumed, the last one may be partial
+      int bits;           // bits of the byte at in - 1 that belong to the next block
+      std::vector<unsigned char> window;
+    };
+
+    // checkpoints of every zlib entry that was read with readRange, sorted by out
+    class Checkpoints {
+    public:
+      explicit Checkpoints(std::uint64_t interval) : mInterval(interval) {}
+
+      std::uint64_t interval() const { return mInterval; }
+      // nearest checkpoint at or before offset
+      bool find(int index, std::uint64_t offset, Checkpoint& checkpoint) const;
+      // output offset of the last checkpoint, 0 without any
+      std::uint64_t last(int index) const;
+      void add(int index, Checkpoint checkpoint);
+
+    private:
+      mutable std::mutex mCriticalSection;
+      const std::uint64_t mInterval;
+      std::unordered_map<int, std::vector<Checkpoint>> mEntries;
+    };
+
+    // reads size bytes of the stored payload at offset
+    using PayloadSource = std::function<bool(std::uint64_t offset, char* data, std::size_t size)>;
+
+    // inflates the zlib payload only as far as needed to fill out with length bytes starting at offset,
+    // starting from and adding to checkpoints when given
+    bool inflateRange(const PayloadSource& read, std::uint64_t compressedSize, std::uint64_t offset,
+                      std::size_t length, char* out, int index, Checkpoints* checkpoints);
+  }  // namespace impl
+}  // namespace fdb
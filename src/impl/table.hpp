@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace fdb {
+  class Source;
+  namespace impl {
+    constexpr std::uint32_t INDEX_MAGIC = 0x46444249;
+    constexpr std::uint32_t INDEX_VERSION = 1;
+
+#pragma pack(push, 4)
+    // start of an index file, followed by the arrays of the table in the order of Table's members
+    struct IndexHeader {
+      std::uint32_t magic{INDEX_MAGIC};
+      std::uint32_t version{INDEX_VERSION};
+      std::uint32_t count;
+      std::uint32_t nameBytes;
+      // of the archive the index was built from, a different archive makes it stale
+      std::uint64_t archiveSize;
+      std::int64_t archiveTime;
+      Format format;
+      std::uint32_t reserved{0};
+    };
+#pragma pack(pop)
+
+    // size and modification time, enough to tell whether an archive changed since its index was written
+    struct Stamp {
+      std::uint64_t size{0};
+      std::int64_t time{0};
+      static Stamp of(const char* file);
+    };
+
+    // file table of an open archive as parallel arrays in one buffer, 24 bytes per entry plus its name
+    // the buffer has the layout of an index file, so it is either owned or a read only mapping of one that
+    // every process opening the same archive shares
+    class Table {
+    public:
+      Table() = default;
+      Table(const Table&) = delete;
+      Table& operator=(const Table&) = delete;
+      ~Table() { clear(); }
+
+      // count stored entries and the names at offset, right after the archive header
+      bool read(const Source& source, std::uint64_t offset, Format format, std::uint32_t count);
+      // index file written by save() for the same archive, false if it is missing, broken or stale
+      bool map(const char* index, Format format, std::uint32_t count, const Stamp& archive);
+      // writes to a temporary file first, readers never see half an index
+      bool save(const char* index, const Stamp& archive) const;
+      void clear();
+
+      std::uint32_t size() const { return mCount; }
+      FileTableEntry entry(std::uint32_t index) const { return {type(index), mTimes[index], offset(index)}; }
+      std::uint64_t offset(std::uint32_t index) const { return mEntries[index] & OFFSET_MASK; }
+      FileType type(std::uint32_t index) const { return static_cast<FileType>(mEntries[index] >> TYPE_SHIFT); }
+      const char* name(std::uint32_t index) const { return mNames + mNameOffsets[index]; }
+      // first entry with that name, -1 if there is none
+      int find(const char* name) const;
+
+      // bytes of the table, shared ones are only counted once per machine
+      std::size_t bytes() const { return mBytes; }
+      bool shared() const { return mMapping != nullptr; }
+
+    private:
+      // the type sits in the top byte of the offset, no valid archive comes close to 2^56 bytes
+      static constexpr int TYPE_SHIFT = 56;
+      static constexpr std::uint64_t OFFSET_MASK = (std::uint64_t(1) << TYPE_SHIFT) - 1;
+
+      static std::size_t layoutSize(std::uint32_t count, std::uint32_t nameBytes);
+      // points the arrays into a buffer with an IndexHeader in front
+      void layout(const char* buffer);
+      // fills mSorted on first use, parsing an archive doesn't pay for it unless names are looked up
+      void sort() const;
+
+      std::unique_ptr<std::uint64_t[]> mOwned;
+      void* mMapping{nullptr};
+      std::size_t mBytes{0};
+      std::uint32_t mCount{0};
+      std::uint32_t mNameBytes{0};
+
+      const std::uint64_t* mEntries{nullptr};      // offset and type
+      const std::uint64_t* mTimes{nullptr};
+      const std::uint32_t* mNameOffsets{nullptr};  // into mNames, identical names share one string
+      const std::uint32_t* mSorted{nullptr};       // indices ordered by name, for find()
+      const char* mNames{nullptr};
+      mutable std::mutex mSortLock;
+      mutable std::atomic<bool> mSortDone{false};
+    };
+  }  // namespace impl
+}  // namespace fdb
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "zlib.h"
+
+namespace fdb {
+  namespace impl {
+    // zlib inflate over chunked input, every filled output chunk is handed to a sink
+    class Inflater {
+    public:
+      enum class Result { more, end, error, stopped };
+
+      explicit Inflater(std::size_t bufsize = 64 * 1024) : mOut(bufsize) {}
+      ~Inflater() {
+        if (mInit) inflateEnd(&mStrm);
+      }
+      Inflater(const Inflater&) = delete;
+      Inflater& operator=(const Inflater&) = delete;
+
+      bool reset(int windowBits = MAX_WBITS) {
+        if (mInit) return inflateReset2(&mStrm, windowBits) == Z_OK;
+        mStrm.zalloc = Z_NULL;
+        mStrm.zfree = Z_NULL;
+        mStrm.opaque = Z_NULL;
+        mStrm.avail_in = 0;
+        mStrm.next_in = Z_NULL;
+        mInit = inflateInit2(&mStrm, windowBits) == Z_OK;
+        return mInit;
+      }
+      // sink(const char*, std::size_t) returns false to stop early
+      template <typename Sink>
+      Result feed(const char* data, std::size_t size, Sink&& sink) {
+        mStrm.next_in = (Bytef*)data;
+        mStrm.avail_in = static_cast<uInt>(size);
+        do {
+          mStrm.next_out = (Bytef*)mOut.data();
+          mStrm.avail_out = static_cast<uInt>(mOut.size());
+          auto ret = inflate(&mStrm, Z_NO_FLUSH);
+          switch (ret) {
+            case Z_NEED_DICT:
+            case Z_STREAM_ERROR:
+            case Z_DATA_ERROR:
+            case Z_MEM_ERROR:
+              return Result::error;
+          }
+          const std::size_t produced = mOut.size() - mStrm.avail_out;
+          if (produced > 0 && !sink(mOut.data(), produced)) return Result::stopped;
+          if (ret == Z_STREAM_END) return Result::end;
+          if (ret == Z_BUF_ERROR) break;
+        } while (mStrm.avail_out == 0 || mStrm.avail_in > 0);
+        return Result::more;
+      }
+      std::size_t pending() const { return mStrm.avail_in; }
+      std::uint64_t total() const { return mStrm.total_out; }
+      z_stream& stream() { return mStrm; }
+
+    private:
+      z_stream mStrm{};
+      bool mInit{false};
+      std::vector<char> mOut;
+    };
+  }  // namespace impl
+}  // namespace fdb
@@ -0,0 +1,176 @@
+#include "live.hpp"
+
+#include <cerrno>
+#include <condition_variable>
+#include <filesystem>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fdb {
+  namespace impl {
+    // reloads a LiveReader whenever its file is replaced
+    class Watcher {
+    public:
+      Watcher(LiveReader& live, const std::string& path, std::function<void(bool)> callback,
+              std::chrono::milliseconds interval)
+          : mLive(live), mCallback(std::move(callback)), mInterval(interval) {
+        const std::filesystem::path p(path);
+        mName = p.filename().string();
+        mPath = path;
+#ifdef __linux__
+        const auto dir = p.has_parent_path() ? p.parent_path().string() : std::string(".");
+        mNotify = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+        mWake = eventfd(0, EFD_CLOEXEC);
+        // the directory is watched, a rename replaces the inode a watch on the file itself would follow
+        if (mNotify < 0 || mWake < 0 || inotify_add_watch(mNotify, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+          return;
+        }
+#else
+        mStamp = stamp();
+#endif
+        mThread = std::thread(&Watcher::run, this);
+      }
+      ~Watcher() {
+#ifdef __linux__
+        if (mWake >= 0) {
+          const std::uint64_t one = 1;
+          [[maybe_unused]] auto n = ::write(mWake, &one, sizeof(one));
+        }
+#else
+        {
+          std::lock_guard<std::mutex> l(mCriticalSection);
+          mStop = true;
+        }
+        mChanged.notify_all();
+#endif
+        if (mThread.joinable()) mThread.join();
+#ifdef __linux__
+        if (mNotify >= 0) ::close(mNotify);
+        if (mWake >= 0) ::close(mWake);
+#endif
+      }
+      Watcher(const Watcher&) = delete;
+      Watcher& operator=(const Watcher&) = delete;
+
+      bool running() const { return mThread.joinable(); }
+
+    private:
+      void changed() {
+        const bool ok = mLive.reload();
+        if (mCallback) mCallback(ok);
+      }
+#ifdef __linux__
+      void run() {
+        alignas(inotify_event) char buffer[4096];
+        for (;;) {
+          pollfd fds[2] = {{mNotify, POLLIN, 0}, {mWake, POLLIN, 0}};
+          if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return;
+          }
+          if (fds[1].revents) return;
+          bool match = false;
+          for (;;) {
+            const auto n = ::read(mNotify, buffer, sizeof(buffer));
+            if (n <= 0) break;
+            for (char* p = buffer; p < buffer + n;) {
+              const auto* event = reinterpret_cast<const inotify_event*>(p);
+              if (event->len > 0 && mName == event->name) match = true;
+              p += sizeof(inotify_event) + event->len;
+            }
+          }
+          // several events of one patch are drained together and cause a single reload
+          if (match) changed();
+        }
+      }
+#else
+      std::pair<std::filesystem::file_time_type, std::uintmax_t> stamp() const {
+        std::error_code ec;
+        return {std::filesystem::last_write_time(mPath, ec), std::filesystem::file_size(mPath, ec)};
+      }
+      void run() {
+        std::unique_lock<std::mutex> l(mCriticalSection);
+        while (!mChanged.wait_for(l, mInterval, [&] { return mStop; })) {
+          const auto now = stamp();
+          if (now == mStamp) continue;
+          mStamp = now;
+          l.unlock();
+          changed();
+          l.lock();
+        }
+      }
+#endif
+
+    private:
+      LiveReader& mLive;
+      const std::function<void(bool)> mCallback;
+      const std::chrono::milliseconds mInterval;
+      std::string mPath;
+      std::string mName;
+#ifdef __linux__
+      int mNotify{-1};
+      int mWake{-1};
+#else
+      std::mutex mCriticalSection;
+      std::condition_variable mChanged;
+      std::pair<std::filesystem::file_time_type, std::uintmax_t> mStamp;
+      bool mStop{false};
+#endif
+      std::thread mThread;
+    };
+  }  // namespace impl
+
+  LiveReader::LiveReader() = default;
+  LiveReader::LiveReader(const char* file) { open(file); }
+  LiveReader::~LiveReader() { close(); }
+
+  bool LiveReader::open(const char* file) {
+    close();
+    {
+      std::lock_guard<std::mutex> l(mReloading);
+      mPath = file;
+    }
+    return reload();
+  }
+  void LiveReader::close() {
+    unwatch();
+    std::lock_guard<std::mutex> l(mReloading);
+    mPath.clear();
+    std::atomic_store(&mCurrent, std::shared_ptr<const Reader>());
+  }
+
+  bool LiveReader::reload() {
+    std::lock_guard<std::mutex> l(mReloading);
+    if (mPath.empty()) return false;
+    // table and names are read before anyone sees the new reader
+    auto next = std::make_shared<const Reader>(mPath.c_str());
+    if (!*next) return false;
+    std::atomic_store(&mCurrent, std::move(next));
+    ++mGeneration;
+    return true;
+  }
+
+  bool LiveReader::watch(std::function<void(bool)> callback, std::chrono::milliseconds interval) {
+    unwatch();
+    std::string path;
+    {
+      std::lock_guard<std::mutex> l(mReloading);
+      path = mPath;
+    }
+    if (path.empty()) return false;
+    auto watcher = std::make_unique<impl::Watcher>(*this, path, std::move(callback), interval);
+    if (!watcher->running()) return false;
+    mWatcher = std::move(watcher);
+    return true;
+  }
+  void LiveReader::unwatch() {
+    // joins the watcher thread, so this must not be called from the callback
+    mWatcher = nullptr;
+  }
+}  // namespace fdb
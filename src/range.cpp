@@ -0,0 +1,122 @@
+#include "impl/range.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "zlib.h"
+
+namespace {
+  constexpr std::size_t CHUNK = 16 * 1024;
+
+  struct Stream {
+    z_stream strm{};
+    bool init{false};
+    ~Stream() {
+      if (init) inflateEnd(&strm);
+    }
+  };
+}  // namespace
+
+namespace fdb {
+  namespace impl {
+    bool Checkpoints::find(int index, std::uint64_t offset, Checkpoint& checkpoint) const {
+      std::lock_guard<std::mutex> l(mCriticalSection);
+      auto it = mEntries.find(index);
+      if (it == mEntries.end()) return false;
+      const auto& list = it->second;
+      auto pos = std::upper_bound(list.begin(), list.end(), offset,
+                                  [](std::uint64_t o, const Checkpoint& c) { return o < c.out; });
+      if (pos == list.begin()) return false;
+      checkpoint = *std::prev(pos);
+      return true;
+    }
+    std::uint64_t Checkpoints::last(int index) const {
+      std::lock_guard<std::mutex> l(mCriticalSection);
+      auto it = mEntries.find(index);
+      return it == mEntries.end() || it->second.empty() ? 0 : it->second.back().out;
+    }
+    void Checkpoints::add(int index, Checkpoint checkpoint) {
+      std::lock_guard<std::mutex> l(mCriticalSection);
+      auto& list = mEntries[index];
+      auto pos = std::lower_bound(list.begin(), list.end(), checkpoint.out,
+                                  [](const Checkpoint& c, std::uint64_t o) { return c.out < o; });
+      // two readers racing over the same stretch find the same block boundaries
+      if (pos != list.end() && pos->out == checkpoint.out) return;
+      list.insert(pos, std::move(checkpoint));
+    }
+
+    bool inflateRange(const PayloadSource& read, std::uint64_t compressedSize, std::uint64_t offset,
+                      std::size_t length, char* out, int index, Checkpoints* checkpoints) {
+      Stream s;
+      auto& strm = s.strm;
+      std::vector<unsigned char> input(CHUNK);
+      // output goes round through the window, so it always holds the last 32 KB for the next checkpoint
+      std::vector<unsigned char> window(WINDOW_SIZE);
+      std::uint64_t in = 0;
+      std::uint64_t total = 0;
+
+      Checkpoint start;
+      const bool resume = checkpoints && checkpoints->find(index, offset, start);
+      // checkpoints sit behind the zlib header, from there on the stream is raw deflate
+      if (inflateInit2(&strm, resume ? -MAX_WBITS : MAX_WBITS) != Z_OK) return false;
+      s.init = true;
+      if (resume) {
+        in = start.in;
+        total = start.out;
+        if (start.bits) {
+          char byte;
+          if (!read(in - 1, &byte, 1)) return false;
+          inflatePrime(&strm, start.bits, static_cast<unsigned char>(byte) >> (8 - start.bits));
+        }
+        inflateSetDictionary(&strm, start.window.data(), WINDOW_SIZE);
+        window = std::move(start.window);
+      }
+      strm.next_out = window.data();
+      strm.avail_out = WINDOW_SIZE;
+
+      const std::uint64_t interval = checkpoints ? checkpoints->interval() : 0;
+      std::uint64_t next = std::numeric_limits<std::uint64_t>::max();
+      if (interval) next = std::max(checkpoints->last(index), total) + interval;
+
+      const std::uint64_t end = offset + length;
+      for (;;) {
+        if (strm.avail_in == 0) {
+          if (in >= compressedSize) return false;
+          const auto n = static_cast<std::size_t>(std::min<std::uint64_t>(CHUNK, compressedSize - in));
+          if (!read(in, (char*)input.data(), n)) return false;
+          in += n;
+          strm.next_in = input.data();
+          strm.avail_in = static_cast<uInt>(n);
+        }
+        if (strm.avail_out == 0) {
+          strm.next_out = window.data();
+          strm.avail_out = WINDOW_SIZE;
+        }
+        auto* before = strm.next_out;
+        // Z_BLOCK returns at every block boundary, the only places inflate can be resumed from
+        const int ret = inflate(&strm, Z_BLOCK);
+        if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR || ret == Z_STREAM_ERROR) return false;
+
+        const std::uint64_t produced = strm.next_out - before;
+        const auto from = std::max(total, offset);
+        const auto to = std::min(total + produced, end);
+        if (from < to) memcpy(out + (from - offset), before + (from - total), static_cast<std::size_t>(to - from));
+        total += produced;
+        if (total >= end) return true;
+        if (ret == Z_STREAM_END) return false;
+
+        // bit 128: at a block boundary, bit 64: after the last block
+        if (total >= next && (strm.data_type & 128) && !(strm.data_type & 64)) {
+          Checkpoint c{total, in - strm.avail_in, strm.data_type & 7, std::vector<unsigned char>(WINDOW_SIZE)};
+          // oldest bytes are the ones about to be overwritten
+          const std::size_t left = strm.avail_out;
+          memcpy(c.window.data(), window.data() + WINDOW_SIZE - left, left);
+          memcpy(c.window.data() + left, window.data(), WINDOW_SIZE - left);
+          checkpoints->add(index, std::move(c));
+          next = total + interval;
+        }
+      }
+    }
+  }  // namespace impl
+}  // namespace fdb
@@ -3,13 +3,47 @@
 #include <exception>
 
 #include "ImageFile.hpp"
+#include "codec.hpp"
 #include "impl/base.hpp"
+#include "impl/block.hpp"
+#include "impl/prefetch.hpp"
+#include "impl/range.hpp"
+#include "impl/table.hpp"
+#include "impl/zstream.hpp"
 #include <algorithm>
 #include <cctype>
+#include <cstring>
+
+namespace {
+  // format and number of entries from the archive header, the table follows it
+  bool header(const fdb::Source& source, fdb::Format& format, std::uint32_t& filecount) {
+    std::uint32_t magic = 0;
+    if (!source.read(0, (char*)&magic, sizeof(magic))) return false;
+    if (magic == fdb::impl::MAGIC) {
+      fdb::impl::FDBHeader hdr;
+      if (!source.read(0, (char*)&hdr, sizeof(hdr))) return false;
+      filecount = hdr.filecount;
+      format = fdb::Format::classic;
+    } else if (magic == fdb::impl::MAGIC64) {
+      fdb::impl::FDBHeader64 hdr;
+      // newer versions may change the layout
+      if (!source.read(0, (char*)&hdr, sizeof(hdr)) || hdr.version != fdb::impl::VERSION64) return false;
+      filecount = hdr.filecount;
+      format = fdb::Format::extended;
+    } else {
+      return false;
+    }
+    return filecount != 0;
+  }
+  std::uint64_t tableOffset(fdb::Format format) {
+    return format == fdb::Format::classic ? sizeof(fdb::impl::FDBHeader) : sizeof(fdb::impl::FDBHeader64);
+  }
+}  // namespace
+
 namespace fdb {
 
   std::unique_ptr<NormalFile> Reader::get(int index) const {
-    const auto& fte = mFileTable[index];
+    const auto fte = mTable->entry(index);
     if (fte.offset == 0) {
       return nullptr;
     }
@@ -19,127 +53,346 @@ namespace fdb {
     } else {
       res = std::make_unique<ImageFile>();
     }
-    res->name(mFileNames[index]);
+    res->name(mTable->name(index));
     res->time(fte.time);
     std::vector<char> tmp;
-    impl::NormalFileHeader nfh;
+    impl::NormalFileHeader64 nfh;
+    auto offset = fte.offset;
+    auto source = [&](char* data, std::size_t size) {
+      if (!read(offset, data, size)) return false;
+      offset += size;
+      return true;
+    };
+    if (!impl::readHeader(source, mFormat, nfh)) return nullptr;
+    offset += nfh.namelength;
+    // sizes are only checked against sanity limits, an entry that claims more than the archive holds is damaged
+    const auto imageHeader = res->isImage() ? sizeof(impl::ImageFileHeader) : 0;
+    if (offset + imageHeader + impl::payloadSize(nfh) > mSource->size()) return nullptr;
+    if (res->isImage()) {
+      impl::ImageFileHeader f;
+      if (!source((char*)&f, sizeof(f))) return nullptr;
+      auto& _hdr = ((ImageFile*)res.get())->getHeader();
+      _hdr.height = f.height;
+      _hdr.width = f.width;
+      _hdr.mipmap = f.mipmap;
+      _hdr.type = f.type;
+      std::copy(std::begin(f.unk), std::end(f.unk), std::begin(_hdr.unk));
+    }
+    tmp.resize(static_cast<std::size_t>(impl::payloadSize(nfh)));
+    if (!tmp.empty() && !source(tmp.data(), tmp.size())) return nullptr;
     {
       std::lock_guard<std::mutex> l(mCriticalSection);
-      mPackage.seekg(fte.offset);
-
-      mPackage.read((char*)&nfh, sizeof(nfh));
-      if (nfh.size_uncompressed >> 31) {
-        // check highest bit
-        // if the file is bigger than 2GB than there is something horribly wrong
-        return nullptr;
-      }
-      if (nfh.size_uncompressed == 0) {
-        return nullptr;
-      }
-      if (nfh.size_compressed > 0x10000000) {
-        return nullptr;
-      }
-
-      if (nfh.namelength > 0x200) {
-        return nullptr;
-      }
-
-      mPackage.seekg(nfh.namelength, std::ios::cur);
-      if (res->isImage()) {
-        auto hdr = ((ImageFile*)res.get())->getHeader();
-
-        impl::ImageFileHeader f;
-        mPackage.read((char*)&f, sizeof(f));
-        auto& _hdr = ((ImageFile*)res.get())->getHeader();
-        _hdr.height = f.height;
-        _hdr.width = f.width;
-        _hdr.mipmap = f.mipmap;
-        _hdr.type = f.type;
-      }
-      tmp.resize(nfh.compression == Compression::none ? nfh.size_uncompressed : nfh.size_compressed);
-      if (!tmp.empty()) {
-        mPackage.read((char*)&tmp.front(), tmp.size());
-      }
+      accessed(index, tmp.size());
     }
     res->data(std::move(tmp), nfh.compression, nfh.size_uncompressed);
     return res;
   }
 
-  bool Reader::open(const char* file) {
-    close();
-
-    mPackage.open(file, std::ios::binary);
-    if (!mPackage.is_open()) return *this;
-
-    impl::FDBHeader hdr;
-    mPackage.read((char*)&hdr, sizeof(hdr));
-
-    if (hdr.magic != impl::MAGIC) return *this;
-    if (hdr.filecount == 0) return *this;
-
-    // read filetable
-    mFileTable.resize(hdr.filecount);
-    mPackage.read((char*)&mFileTable.front(), sizeof(decltype(mFileTable)::value_type) * hdr.filecount);
-
-    // read filenames
-    mFileNames.resize(hdr.filecount);
-
-    std::vector<int> len;
-    len.resize(hdr.filecount);
-    mPackage.read((char*)&len.front(), hdr.filecount * sizeof(int));
+  Reader::Reader() : mTable(std::make_unique<impl::Table>()) {}
+  Reader::Reader(const char* file, const char* index) : Reader() { open(file, index); }
+  Reader::Reader(std::shared_ptr<const Source> source) : Reader() { open(std::move(source)); }
+  Reader::~Reader() { close(); }
 
-    int namelen = 0;
-    mPackage.read((char*)&namelen, sizeof(namelen));
-    mNames = std::make_unique<char[]>(namelen);
-    mPackage.read(mNames.get(), namelen);
+  bool Reader::open(const char* file, const char* index) {
+    close();
+    // the stamp is taken before the table is read, a concurrent rewrite leaves a stale index behind at worst
+    const auto stamp = index ? impl::Stamp::of(file) : impl::Stamp{};
+    auto source = std::make_shared<FileSource>(file);
+    if (!*source) return *this;
+    std::uint32_t filecount = 0;
+    if (!header(*source, mFormat, filecount)) return *this;
+    mSource = std::move(source);
 
-    for (std::uint32_t i = 0, offset = 0; i < hdr.filecount; ++i) {
-      mFileNames[i] = mNames.get() + offset;
-      offset += len[i] + 1;
+    if (index && mTable->map(index, mFormat, filecount, stamp)) return *this;
+    if (!mTable->read(*mSource, tableOffset(mFormat), mFormat, filecount)) {
+      mSource = nullptr;
+      return *this;
     }
-    for (auto f : mFileNames) {
-      std::string p = f;
-      std::replace(p.begin(), p.end(), '\\', '/');
-      p.erase(p.begin(), std::find_if(p.begin(), p.end(), [](auto c) { return !(c == '/' || c == '.'); }));
-      std::transform(p.begin(), p.end(), p.begin(), ::tolower);
-      memcpy(f, p.c_str(), p.size() + 1); // copy null terminator
+    // the first one to open the archive writes the index, everyone after that maps it
+    if (index && mTable->save(index, stamp)) {
+      auto shared = std::make_unique<impl::Table>();
+      if (shared->map(index, mFormat, filecount, stamp)) mTable = std::move(shared);
     }
     return *this;
   }
+  bool Reader::open(std::shared_ptr<const Source> source) {
+    close();
+    std::uint32_t filecount = 0;
+    if (!source || !header(*source, mFormat, filecount)) return *this;
+    if (mTable->read(*source, tableOffset(mFormat), mFormat, filecount)) mSource = std::move(source);
+    return *this;
+  }
   void Reader::close() {
+    stopPrefetch();
     std::lock_guard<std::mutex> l(mCriticalSection);
-    mPackage.close();
-    mFileTable.clear();
-    mFileNames.clear();
-    mNames = nullptr;
+    mSource = nullptr;
+    mFormat = Format::classic;
+    mTrace = nullptr;
+    mCheckpoints = nullptr;
+    mTable->clear();
   }
   FileInfo Reader::info(int index) const {
     FileInfo f;
-    const auto& fte = mFileTable[index];
-    f.name = mFileNames[index];
+    const auto fte = mTable->entry(index);
+    f.name = mTable->name(index);
     f.time = fte.time;
     if (fte.offset == 0) {
       return f;
     } 
 
-    impl::NormalFileHeader nfh;
-
-    std::lock_guard<std::mutex> l(mCriticalSection);
-    mPackage.seekg(fte.offset);
-    mPackage.read((char*)&nfh, sizeof(nfh));
+    impl::NormalFileHeader64 nfh;
+    auto offset = fte.offset;
+    const bool ok = impl::readHeader(
+        [&](char* data, std::size_t size) {
+          if (!read(offset, data, size)) return false;
+          offset += size;
+          return true;
+        },
+        mFormat, nfh);
+    {
+      std::lock_guard<std::mutex> l(mCriticalSection);
+      accessed(index, 0);
+    }
+    if (!ok) return f;
 
     f.compressedSize = nfh.size_compressed;
     f.expectedSize = nfh.size_uncompressed;
     f.compression = nfh.compression;
     return f;
   }
+  std::shared_ptr<const Source> Reader::source(int index) const {
+    PayloadLocation location;
+    if (!payload(index, location)) return nullptr;
+    if (location.compression == Compression::none) {
+      auto range = std::make_shared<RangeSource>(mSource, location.offset, location.size);
+      // a truncated archive leaves an empty range
+      if (range->size() != location.size) return nullptr;
+      std::lock_guard<std::mutex> l(mCriticalSection);
+      accessed(index, 0);
+      return range;
+    }
+    // the expected size is only a claim of the entry header until the payload has decoded to it
+    std::vector<char> data;
+    data.reserve(static_cast<std::size_t>(std::min<std::uint64_t>(location.expectedSize, impl::MAX_PACKED_SIZE)));
+    const bool ok = stream(index, [&](const char* chunk, std::size_t size) {
+      if (size > location.expectedSize - data.size()) return false;
+      data.insert(data.end(), chunk, chunk + size);
+      return true;
+    });
+    if (!ok || data.size() != location.expectedSize) return nullptr;
+    return std::make_shared<MemorySource>(std::move(data));
+  }
+  bool Reader::locate(int index, PayloadLocation& location) const {
+    std::lock_guard<std::mutex> l(mCriticalSection);
+    if (!payload(index, location)) return false;
+    accessed(index, 0);
+    return true;
+  }
+  bool Reader::payload(int index, PayloadLocation& location) const {
+    const auto fte = mTable->entry(index);
+    if (fte.offset == 0) return false;
+
+    impl::NormalFileHeader64 nfh;
+    auto offset = fte.offset;
+    auto source = [&](char* data, std::size_t size) {
+      if (!read(offset, data, size)) return false;
+      offset += size;
+      return true;
+    };
+    if (!impl::readHeader(source, mFormat, nfh)) return false;
+
+    location.offset = offset + nfh.namelength;
+    if (fte.type == FileType::image) location.offset += sizeof(impl::ImageFileHeader);
+    location.size = impl::payloadSize(nfh);
+    if (location.offset + location.size > mSource->size()) return false;
+    location.compression = nfh.compression;
+    location.expectedSize = nfh.size_uncompressed;
+    return true;
+  }
+  bool Reader::read(std::uint64_t offset, char* data, std::size_t size) const {
+    return mSource && mSource->read(offset, data, size);
+  }
+  bool Reader::readRange(int index, std::uint64_t offset, std::size_t length, std::vector<char>& out) const {
+    out.clear();
+    PayloadLocation location;
+    std::shared_ptr<impl::Checkpoints> checkpoints;
+    {
+      std::lock_guard<std::mutex> l(mCriticalSection);
+      if (!payload(index, location)) return false;
+      checkpoints = mCheckpoints;
+    }
+    if (offset >= location.expectedSize) return true;
+    length = static_cast<std::size_t>(std::min<std::uint64_t>(length, location.expectedSize - offset));
+
+    const bool blocks = blockCompressed(location.compression) && available(location.compression);
+    if (location.compression != Compression::none && location.compression != Compression::zlib && !blocks) {
+      // nothing to stream these with, the whole entry has to be decoded
+      auto file = get(index);
+      if (!file || !file->decompress() || file->get().size() < offset + length) return false;
+      out.assign(file->get().begin() + offset, file->get().begin() + offset + length);
+      return true;
+    }
+
+    out.resize(length);
+    auto source = [&](std::uint64_t at, char* data, std::size_t size) {
+      return read(location.offset + at, data, size);
+    };
+    bool ok;
+    if (location.compression == Compression::none) {
+      ok = source(offset, out.data(), length);
+    } else if (blocks) {
+      impl::BlockIndex blockIndex;
+      ok = impl::readIndex(source, location.size, location.expectedSize, blockIndex) &&
+           impl::decompressRange(location.compression, source, blockIndex, offset, length, out.data());
+    } else {
+      ok = impl::inflateRange(source, location.size, offset, length, out.data(), index, checkpoints.get());
+    }
+    {
+      std::lock_guard<std::mutex> l(mCriticalSection);
+      accessed(index, length);
+    }
+    if (!ok) out.clear();
+    return ok;
+  }
+  void Reader::checkpoints(std::uint64_t interval) {
+    auto checkpoints = interval ? std::make_shared<impl::Checkpoints>(interval) : nullptr;
+    std::lock_guard<std::mutex> l(mCriticalSection);
+    mCheckpoints = std::move(checkpoints);
+  }
+  bool Reader::stream(int index, const Sink& sink, std::size_t bufferSize) const {
+    if (bufferSize == 0) return false;
+    PayloadLocation location;
+    {
+      std::lock_guard<std::mutex> l(mCriticalSection);
+      if (!payload(index, location)) return false;
+    }
+    if (blockCompressed(location.compression) && available(location.compression)) {
+      {
+        std::lock_guard<std::mutex> l(mCriticalSection);
+        accessed(index, location.size);
+      }
+      auto source = [&](std::uint64_t at, char* data, std::size_t size) {
+        return read(location.offset + at, data, size);
+      };
+      impl::BlockIndex blockIndex;
+      return impl::readIndex(source, location.size, location.expectedSize, blockIndex) &&
+             impl::streamBlocks(location.compression, source, blockIndex, bufferSize, sink);
+    }
+    if (location.compression != Compression::none && location.compression != Compression::zlib) {
+      auto file = get(index);
+      if (!file || !file->decompress()) return false;
+      const auto& data = file->get();
+      for (std::size_t pos = 0; pos < data.size(); pos += bufferSize) {
+        if (!sink(data.data() + pos, std::min(bufferSize, data.size() - pos))) return false;
+      }
+      return true;
+    }
+    {
+      std::lock_guard<std::mutex> l(mCriticalSection);
+      accessed(index, location.size);
+    }
+
+    std::vector<char> input(bufferSize);
+    impl::Inflater inflater(bufferSize);
+    const bool zlib = location.compression == Compression::zlib;
+    if (zlib && !inflater.reset()) return false;
+    auto result = impl::Inflater::Result::more;
+    for (std::uint64_t pos = 0; pos < location.size && result == impl::Inflater::Result::more;) {
+      const auto n = static_cast<std::size_t>(std::min<std::uint64_t>(bufferSize, location.size - pos));
+      if (!read(location.offset + pos, input.data(), n)) return false;
+      pos += n;
+      if (!zlib) {
+        if (!sink(input.data(), n)) return false;
+        continue;
+      }
+      result = inflater.feed(input.data(), n, sink);
+    }
+    return !zlib || (result == impl::Inflater::Result::end && inflater.total() == location.expectedSize);
+  }
   int Reader::index(const char* name) const noexcept {
     if (name == nullptr) return -1;
-    for (std::uint32_t i = 0; i < mFileNames.size(); ++i) {
-      if (mFileNames[i] == name) {
-        return i;
-      }
+    return mTable->find(name);
+  }
+  Reader::operator bool() const { return mTable->size() != 0; }
+  std::uint32_t Reader::size() const noexcept { return mTable->size(); }
+  FileTableEntry Reader::entry(int index) const { return mTable->entry(index); }
+  const char* Reader::name(int index) const { return mTable->name(index); }
+  std::vector<std::string> Reader::storedNames() const {
+    // the name lengths and the names follow the entries of the table
+    const std::uint32_t count = mTable->size();
+    const auto entrySize = mFormat == Format::classic ? sizeof(impl::FileTableEntry32) : sizeof(impl::FileTableEntry64);
+    auto offset = tableOffset(mFormat) + count * std::uint64_t(entrySize);
+    std::vector<std::uint32_t> len(count);
+    std::uint32_t namelen = 0;
+    if (!read(offset, (char*)len.data(), count * sizeof(std::uint32_t))) return {};
+    offset += count * sizeof(std::uint32_t);
+    if (!read(offset, (char*)&namelen, sizeof(namelen))) return {};
+    std::vector<char> stored(namelen);
+    if (!read(offset + sizeof(namelen), stored.data(), namelen)) return {};
+    std::vector<std::string> res;
+    res.reserve(count);
+    for (std::uint32_t i = 0, at = 0; i < count; ++i) {
+      if (at >= namelen) return {};
+      // the stored length, up to the terminator
+      res.emplace_back(stored.data() + at, strnlen(stored.data() + at, std::min<std::size_t>(len[i], namelen - at)));
+      at += len[i] + 1;
+    }
+    return res;
+  }
+  std::size_t Reader::tableBytes() const noexcept { return mTable->bytes(); }
+  bool Reader::sharedTable() const noexcept { return mTable->shared(); }
+
+  void Reader::accessed(int index, std::uint64_t bytes) const {
+    // called with mCriticalSection held
+    if (mTrace) {
+      const auto now = std::chrono::steady_clock::now();
+      const auto us = std::chrono::duration_cast<std::chrono::microseconds>(now - mTraceStart).count();
+      // traces count bytes in 32 bits, huge entries are clamped
+      const auto clamped = static_cast<std::uint32_t>(std::min<std::uint64_t>(bytes, UINT32_MAX));
+      mTrace->add(index, static_cast<std::uint64_t>(us), clamped);
+    }
+    if (mPrefetcher) {
+      mPrefetcher->accessed(index);
+    }
+  }
+  void Reader::startTrace() {
+    std::lock_guard<std::mutex> l(mCriticalSection);
+    mTrace = std::make_unique<AccessTrace>();
+    mTraceStart = std::chrono::steady_clock::now();
+  }
+  AccessTrace Reader::stopTrace() {
+    std::lock_guard<std::mutex> l(mCriticalSection);
+    AccessTrace res;
+    if (mTrace) res = std::move(*mTrace);
+    mTrace = nullptr;
+    return res;
+  }
+  bool Reader::prefetch(const AccessTrace& trace, const PrefetchOptions& options) {
+    stopPrefetch();
+    std::vector<impl::Prefetcher::Target> targets;
+    targets.reserve(trace.size());
+    for (const auto& r : trace.records()) {
+      // a trace of another archive may point anywhere
+      if (r.index >= mTable->size() || mTable->offset(r.index) == 0) continue;
+      const auto fte = mTable->entry(r.index);
+      targets.push_back({r.index, fte.offset, fte.type == FileType::image});
     }
-    return -1;
+    if (targets.empty()) return false;
+    auto prefetcher = std::make_unique<impl::Prefetcher>(mSource, mFormat, std::move(targets), options);
+    std::lock_guard<std::mutex> l(mCriticalSection);
+    mPrefetcher = std::move(prefetcher);
+    return true;
+  }
+  void Reader::stopPrefetch() {
+    std::unique_ptr<impl::Prefetcher> prefetcher;
+    {
+      std::lock_guard<std::mutex> l(mCriticalSection);
+      prefetcher = std::move(mPrefetcher);
+    }
+    // the background thread is joined here, outside of the lock
+  }
+  std::uint64_t Reader::prefetched() const {
+    std::lock_guard<std::mutex> l(mCriticalSection);
+    return mPrefetcher ? mPrefetcher->issued() : 0;
   }
 }  // namespace fdb
\ No newline at end of file
@@ -0,0 +1,241 @@
+#include "ImageFile.hpp"
+
+#ifdef _WIN32
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+
+#include "impl/image.hpp"
+
+#define NOMINMAX
+#include <windows.h>
+
+// redux compression based on FDBExtractor by McBen
+namespace {
+  struct DLLWrapper {
+    template <typename Signature>
+    Signature get(const char* name) {
+      return (Signature)GetProcAddress(mDLL, name);
+    }
+    DLLWrapper() = default;
+    explicit DLLWrapper(const char* file) { load(file); }
+    bool load(const char* file) {
+      release();
+      mDLL = LoadLibraryA(file);
+      return mDLL != nullptr;
+    }
+    void release() {
+      if (mDLL) {
+        FreeLibrary(mDLL);
+      }
+    }
+    ~DLLWrapper() { release(); }
+    operator bool() const { return mDLL != nullptr; }
+
+    HMODULE mDLL;
+  };
+
+  DLLWrapper gReduxDll;
+  DLLWrapper gNVTTDll;
+}  // namespace
+namespace redux {
+#pragma pack(push, 4)
+  struct DATA2 {
+    void* new_data;
+    std::uint32_t unk;         // u2a
+    std::uint16_t width;       // u2b
+    std::uint16_t height;      // u2b
+    std::uint8_t mipmapcount;  // u2c
+    std::uint8_t pixelformat;
+    std::uint16_t padding;  // 16 bytes padding?
+  };
+  struct DATA {
+    DATA2 data;
+    std::uint8_t* imageData;  // pointer containing image data
+    std::uint8_t* unk;        // probably a pointer...
+    std::uint8_t* tempData;   // temporary Pointer?
+
+    std::uint32_t imageSize;  // sizeof imageData
+    std::uint32_t page_size;
+    std::uint32_t total_size;
+
+    const char* filename;
+    bool has_data;
+  };
+#pragma pack(pop)
+  constexpr std::uint32_t TopBit(std::uint32_t size) {
+    std::uint32_t power = (size > 0) ? 1 : 0;
+    while (power < size) power *= 2;
+    return power;
+  }
+  constexpr std::uint32_t getImageSize(std::int32_t format, std::int32_t mipmapcount, std::int32_t width,
+                                       std::int32_t height) {
+    return fdb::impl::imageSize(format, mipmapcount, width, height);
+  }
+  constexpr std::uint8_t getPixelFormat(const DATA2& data) {
+    switch (data.pixelformat) {
+      case 0:
+      case 4:
+        return 4;
+      case 1:
+        return 5;
+      case 8:
+        return 3;
+      case 9:
+        return 7;
+      case 16:
+      case 20:
+        return 2;
+      case 17:
+        return 8;
+      case 21:
+        return 6;
+      case 24:
+        return 1;
+    }
+    return 0;
+  }
+
+  struct redux_status {
+    uint32_t k1;
+    uint32_t k2;
+    uint32_t k3;
+    size_t size;
+  };
+
+  using t_HandleDecompress = int (*)(char* data, int src_size, DATA* dst);
+  using t_CallbackSet = int (*)(unsigned nr, void* fct);
+  using t_HandleGetOutputDesc = int (*)(int a1, int a2, void* a3);
+
+  t_HandleDecompress handleDecompress{nullptr};
+  t_CallbackSet callbackSet{nullptr};
+  t_HandleGetOutputDesc handleGetOutputDesc{nullptr};
+
+  void* __stdcall CallbackBuffer(std::int32_t a1, DATA** _data, std::int32_t index, std::int32_t mipmaplevel,
+                                 redux_status* status) {
+    // void* __stdcall redux_callback2(int a1, a1_struct* a2, int a3, int a4, redux_status* a5)
+    auto data = *_data;
+    data->has_data = true;
+    if (mipmaplevel == 0) {
+      DATA2 inner;
+      handleGetOutputDesc(a1, index, &inner);
+      inner.width = TopBit(inner.width);
+      inner.height = TopBit(inner.height);
+
+      data->data = inner;
+      data->imageSize = getImageSize(getPixelFormat(inner), inner.mipmapcount, inner.width, inner.height);
+      data->imageData = nullptr;
+      data->tempData = nullptr;
+      data->total_size = 0;
+      if (data->imageSize > 0) {
+        data->imageData = new std::uint8_t[data->imageSize];
+      } else {
+        data->tempData = new std::uint8_t[status->size];
+      }
+    } else {
+      data->total_size += data->page_size;
+      if (!data->tempData && data->total_size >= data->imageSize && data->page_size > 0) {
+        data->tempData = new std::uint8_t[data->page_size];
+      }
+    }
+    data->page_size = status->size;
+    if (data->tempData) {
+      return data->tempData;
+    }
+    return data->imageData + data->total_size;
+  }
+  void __stdcall CallbackOnComplete(std::int32_t, DATA** _data, std::int32_t) {
+    // void* __stdcall redux_callback1(int a1, a1_struct* a2, int a3)
+    auto data = *_data;
+    data->has_data = true;
+    if (data->tempData) {
+      delete[] data->tempData;
+      data->tempData = nullptr;
+    }
+  }
+
+  bool load(const char* path) {
+    if (gReduxDll) return gReduxDll;
+    if (path!=nullptr) {
+      std::filesystem::path p(path);
+      if (gNVTTDll.load((p / "redux_nvtt.dll").string().c_str())) {
+        gReduxDll.load((p / "redux_runtime.dll").string().c_str());
+      }
+    } 
+    if (!gReduxDll) {
+      if (gNVTTDll.load( "redux_nvtt.dll")) {
+        gReduxDll.load("redux_runtime.dll");
+      }
+    }
+    if (!gReduxDll) {
+      gNVTTDll.release();
+      return false;
+    }
+    handleDecompress = gReduxDll.get<t_HandleDecompress>("reduxHandleDecompress");
+    callbackSet = gReduxDll.get<t_CallbackSet>("reduxCallbackSet");
+    handleGetOutputDesc = gReduxDll.get<t_HandleGetOutputDesc>("reduxHandleGetOutputDesc");
+    if (!handleDecompress || !callbackSet || !handleGetOutputDesc) {
+      gReduxDll.release();
+      gNVTTDll.release();
+      return false;
+    }
+    callbackSet(7, (void*)&CallbackOnComplete);
+    callbackSet(6, (void*)&CallbackBuffer);
+    return true;
+  }
+
+  class Decoder : public fdb::ImageFile::Decoder {
+  public:
+    bool decode(Context*, const std::vector<char>& in, fdb::ImageFile::Header& hdr,
+                std::vector<char>& out) const override {
+      if (in.empty()) return false;
+      // the callbacks only touch the DATA passed in, but nothing is known about the runtime itself
+      std::lock_guard<std::mutex> l(mCriticalSection);
+      redux::DATA reduxData;
+      memset(&reduxData, 0, sizeof(reduxData));
+      reduxData.filename = "dummy";
+      // the runtime takes a mutable pointer but doesn't write to the source
+      auto res = redux::handleDecompress(const_cast<char*>(in.data()), static_cast<int>(in.size()), &reduxData);
+      if (res != 0 || reduxData.imageSize == 0) {
+        return false;
+      }
+      out.assign(reduxData.imageData, reduxData.imageData + reduxData.imageSize);
+
+      hdr.height = reduxData.data.height;
+      hdr.width = reduxData.data.width;
+      hdr.mipmap = reduxData.data.mipmapcount;
+      hdr.type = redux::getPixelFormat(reduxData.data);
+
+      delete[] reduxData.imageData;
+      return true;
+    }
+
+  private:
+    mutable std::mutex mCriticalSection;
+  };
+}  // namespace redux
+
+namespace fdb {
+  std::shared_ptr<const ImageFile::Decoder> reduxDecoder(const char* path) {
+    static std::mutex criticalSection;
+    static std::shared_ptr<const ImageFile::Decoder> decoder;
+    std::lock_guard<std::mutex> l(criticalSection);
+    if (!decoder && redux::load(path)) {
+      decoder = std::make_shared<redux::Decoder>();
+    }
+    return decoder;
+  }
+  bool initRedux(const char* path) {
+    auto decoder = reduxDecoder(path);
+    if (!decoder) return false;
+    ImageFile::decoder(std::move(decoder));
+    return true;
+  }
+}  // namespace fdb
+#else
+namespace fdb {
+  std::shared_ptr<const ImageFile::Decoder> reduxDecoder(const char*) { return nullptr; }
+  bool initRedux(const char*) { return false; }
+}  // namespace fdb
+#endif
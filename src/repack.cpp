@@ -0,0 +1,222 @@
+#include "repack.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#include "codec.hpp"
+#include "reader.hpp"
+#include "writer.hpp"
+
+namespace {
+  std::string_view groupKey(std::string_view name, fdb::RepackOptions::Grouping grouping) {
+    const auto slash = name.rfind('/');
+    if (grouping == fdb::RepackOptions::Grouping::directory) {
+      return slash == std::string_view::npos ? std::string_view() : name.substr(0, slash);
+    }
+    const auto dot = name.rfind('.');
+    if (dot == std::string_view::npos || (slash != std::string_view::npos && dot < slash)) return {};
+    return name.substr(dot + 1);
+  }
+
+  // reader -> recompression workers -> writer, with at most memoryLimit payload bytes in between
+  class Pipeline {
+  public:
+    Pipeline(const fdb::Reader& rd, fdb::Writer& wr, const std::vector<int>& order,
+             const std::vector<std::string>& names, const fdb::RepackOptions& options)
+        : mReader(rd), mWriter(wr), mOrder(order), mNames(names), mOptions(options), mSlots(order.size()) {}
+
+    bool run(fdb::RepackStats& stats) {
+      std::vector<std::thread> threads;
+      threads.emplace_back(&Pipeline::read, this);
+      unsigned workers = 0;
+      if (mOptions.recompress) {
+        workers = mOptions.threads ? mOptions.threads : std::max(1u, std::thread::hardware_concurrency());
+      }
+      for (unsigned i = 0; i < workers; ++i) {
+        threads.emplace_back(&Pipeline::work, this);
+      }
+      write(stats);
+      for (auto& t : threads) t.join();
+      stats.recompressed = mRecompressed;
+      return !mFailed;
+    }
+
+  private:
+    struct Slot {
+      std::unique_ptr<fdb::NormalFile> file;
+      std::size_t reserved{0};
+      bool ready{false};
+    };
+
+    void read() {
+      for (std::size_t pos = 0; pos < mOrder.size(); ++pos) {
+        {
+          std::unique_lock<std::mutex> l(mCriticalSection);
+          mChanged.wait(l, [&] { return mFailed || mInFlight == 0 || mInFlight < mOptions.memoryLimit; });
+          if (mFailed) break;
+        }
+        auto file = mReader.get(mOrder[pos]);
+        std::lock_guard<std::mutex> l(mCriticalSection);
+        auto& slot = mSlots[pos];
+        slot.reserved = file ? file->get().size() : 0;
+        mInFlight += slot.reserved;
+        const bool recompress = file && mOptions.recompress && !file->isImage();
+        slot.file = std::move(file);
+        if (recompress) {
+          mWork.push_back(pos);
+        } else {
+          slot.ready = true;
+        }
+        mChanged.notify_all();
+      }
+      std::lock_guard<std::mutex> l(mCriticalSection);
+      mReadDone = true;
+      mChanged.notify_all();
+    }
+
+    void work() {
+      for (;;) {
+        std::size_t pos;
+        {
+          std::unique_lock<std::mutex> l(mCriticalSection);
+          mChanged.wait(l, [&] { return !mWork.empty() || mReadDone; });
+          if (mWork.empty()) return;
+          pos = mWork.front();
+          mWork.pop_front();
+        }
+        // failing entries are written as they were read
+        auto& file = *mSlots[pos].file;
+        const bool ok = file.compress(mOptions.compression);
+        std::lock_guard<std::mutex> l(mCriticalSection);
+        if (ok) ++mRecompressed;
+        mSlots[pos].ready = true;
+        mChanged.notify_all();
+      }
+    }
+
+    void write(fdb::RepackStats& stats) {
+      for (std::size_t pos = 0; pos < mOrder.size(); ++pos) {
+        std::unique_ptr<fdb::NormalFile> file;
+        std::size_t reserved;
+        {
+          std::unique_lock<std::mutex> l(mCriticalSection);
+          mChanged.wait(l, [&] { return mSlots[pos].ready || mFailed; });
+          if (mFailed) return;
+          file = std::move(mSlots[pos].file);
+          reserved = mSlots[pos].reserved;
+        }
+        const int index = mOrder[pos];
+        const auto fte = mReader.entry(index);
+        bool ok;
+        if (file) {
+          ok = mWriter.add(*file, mNames[index], index);
+          stats.bytesIn += reserved;
+          stats.bytesOut += file->get().size();
+        } else if (fte.offset == 0) {
+          ok = mWriter.addEmpty(mNames[index], fte.type, fte.time, index);
+          ++stats.empty;
+        } else {
+          // a payload that can't be read is never turned into an empty entry
+          ok = false;
+        }
+        ++stats.entries;
+        file.reset();
+        std::lock_guard<std::mutex> l(mCriticalSection);
+        mInFlight -= reserved;
+        if (!ok) mFailed = true;
+        mChanged.notify_all();
+        if (mFailed) return;
+      }
+    }
+
+    const fdb::Reader& mReader;
+    fdb::Writer& mWriter;
+    const std::vector<int>& mOrder;
+    const std::vector<std::string>& mNames;  // as stored, the reader's are normalized
+    const fdb::RepackOptions& mOptions;
+
+    std::mutex mCriticalSection;
+    std::condition_variable mChanged;
+    std::vector<Slot> mSlots;
+    std::deque<std::size_t> mWork;
+    std::size_t mInFlight{0};
+    std::uint32_t mRecompressed{0};
+    bool mReadDone{false};
+    bool mFailed{false};
+  };
+}  // namespace
+
+namespace fdb {
+  std::vector<int> repackOrder(const Reader& rd, const RepackOptions& options) {
+    std::vector<int> res;
+    res.reserve(rd.size());
+    std::vector<bool> placed(rd.size());
+    if (!options.trace.empty()) {
+      std::unordered_map<std::string_view, int> names;
+      names.reserve(rd.size());
+      for (std::uint32_t i = 0; i < rd.size(); ++i) names.emplace(rd.name(i), i);
+      for (const auto& n : options.trace) {
+        auto it = names.find(n);
+        if (it == names.end() || placed[it->second]) continue;
+        placed[it->second] = true;
+        res.push_back(it->second);
+      }
+    }
+    const auto traced = res.size();
+    for (std::uint32_t i = 0; i < rd.size(); ++i) {
+      if (!placed[i]) res.push_back(i);
+    }
+    auto byOffset = [&](int a, int b) { return rd.entry(a).offset < rd.entry(b).offset; };
+    switch (options.grouping) {
+      case RepackOptions::Grouping::original:
+        break;
+      case RepackOptions::Grouping::offset:
+        std::stable_sort(res.begin() + traced, res.end(), byOffset);
+        break;
+      case RepackOptions::Grouping::directory:
+      case RepackOptions::Grouping::extension:
+        std::stable_sort(res.begin() + traced, res.end(), [&](int a, int b) {
+          const auto ka = groupKey(rd.name(a), options.grouping);
+          const auto kb = groupKey(rd.name(b), options.grouping);
+          return ka != kb ? ka < kb : byOffset(a, b);
+        });
+        break;
+    }
+    return res;
+  }
+
+  bool repack(const char* source, const char* target, const RepackOptions& options, RepackStats* stats) {
+    const auto start = std::chrono::steady_clock::now();
+    std::error_code ec;
+    if (std::filesystem::equivalent(source, target, ec)) return false;
+    if (options.recompress && options.format == Format::classic && blockCompressed(options.compression)) return false;
+    if (options.recompress && !available(options.compression)) return false;
+    Reader rd(source);
+    if (!rd) return false;
+    const auto order = repackOrder(rd, options);
+
+    // names are known up front, so the table can be written in place at the end
+    const auto names = rd.storedNames();
+    if (names.size() != rd.size()) return false;
+    std::uint64_t nameBytes = 0;
+    for (const auto& n : names) nameBytes += n.size() + 1;
+    Writer wr(target, Writer::tableSize(rd.size(), nameBytes, options.format), options.format);
+    if (!wr) return false;
+
+    RepackStats local;
+    Pipeline pipeline(rd, wr, order, names, options);
+    bool ok = pipeline.run(local);
+    ok = wr.close() && ok;
+    local.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (stats) *stats = local;
+    return ok;
+  }
+}  // namespace fdb
@@ -0,0 +1,150 @@
+#include "source.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+  bool fits(std::uint64_t offset, std::uint64_t size, std::uint64_t total) {
+    return offset <= total && size <= total - offset;
+  }
+}  // namespace
+
+namespace fdb {
+#ifndef _WIN32
+  FileSource::FileSource(const char* file) : mFile(::open(file, O_RDONLY | O_CLOEXEC)) {
+    struct stat st;
+    if (mFile >= 0 && fstat(mFile, &st) == 0) mSize = static_cast<std::uint64_t>(st.st_size);
+  }
+  FileSource::FileSource(int fd) : mFile(fd >= 0 ? fcntl(fd, F_DUPFD_CLOEXEC, 0) : -1) {
+    struct stat st;
+    if (mFile >= 0 && fstat(mFile, &st) == 0) mSize = static_cast<std::uint64_t>(st.st_size);
+  }
+  FileSource::~FileSource() {
+    if (mFile >= 0) ::close(mFile);
+  }
+  FileSource::operator bool() const { return mFile >= 0; }
+  bool FileSource::read(std::uint64_t offset, char* data, std::size_t size) const {
+    while (size) {
+      const auto n = ::pread(mFile, data, size, static_cast<off_t>(offset));
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return false;
+      data += n;
+      size -= static_cast<std::size_t>(n);
+      offset += static_cast<std::uint64_t>(n);
+    }
+    return true;
+  }
+  bool FileSource::willNeed([[maybe_unused]] std::uint64_t offset, [[maybe_unused]] std::uint64_t size) const {
+#ifdef __unix__
+    return ::posix_fadvise(mFile, static_cast<off_t>(offset), static_cast<off_t>(size), POSIX_FADV_WILLNEED) == 0;
+#else
+    return false;
+#endif
+  }
+#else
+  FileSource::FileSource(const char* file) : mFile(file, std::ios::binary | std::ios::ate) {
+    if (mFile) mSize = static_cast<std::uint64_t>(mFile.tellg());
+  }
+  FileSource::~FileSource() = default;
+  FileSource::operator bool() const { return mFile.is_open(); }
+  bool FileSource::read(std::uint64_t offset, char* data, std::size_t size) const {
+    std::lock_guard<std::mutex> l(mCriticalSection);
+    mFile.seekg(offset);
+    if (!mFile.read(data, size)) {
+      mFile.clear();
+      return false;
+    }
+    return true;
+  }
+  // no advisory interface
+  bool FileSource::willNeed(std::uint64_t, std::uint64_t) const { return false; }
+#endif
+
+  MemorySource::MemorySource(const void* data, std::size_t size)
+      : mData(static_cast<const char*>(data)), mSize(data ? size : 0) {}
+  MemorySource::MemorySource(std::vector<char> data)
+      : mOwned(std::move(data)), mData(mOwned.data()), mSize(mOwned.size()) {}
+  bool MemorySource::read(std::uint64_t offset, char* data, std::size_t size) const {
+    if (!fits(offset, size, mSize)) return false;
+    if (size) memcpy(data, mData + offset, size);
+    return true;
+  }
+
+  MappedSource::MappedSource(const char* file) {
+#ifndef _WIN32
+    const int fd = ::open(file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    struct stat st;
+    void* mapping = MAP_FAILED;
+    // an empty file can't be mapped, it isn't an archive either
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      mapping = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (mapping == MAP_FAILED) return;
+    mData = static_cast<const char*>(mapping);
+    mSize = static_cast<std::size_t>(st.st_size);
+#else
+    std::ifstream f(file, std::ios::binary | std::ios::ate);
+    if (!f) return;
+    mOwned.resize(static_cast<std::size_t>(f.tellg()));
+    f.seekg(0);
+    if (mOwned.empty() || !f.read(mOwned.data(), mOwned.size())) return;
+    mData = mOwned.data();
+    mSize = mOwned.size();
+#endif
+  }
+  MappedSource::~MappedSource() {
+#ifndef _WIN32
+    if (mData) munmap(const_cast<char*>(mData), mSize);
+#endif
+  }
+  bool MappedSource::read(std::uint64_t offset, char* data, std::size_t size) const {
+    if (!fits(offset, size, mSize)) return false;
+    if (size) memcpy(data, mData + offset, size);
+    return true;
+  }
+  bool MappedSource::willNeed([[maybe_unused]] std::uint64_t offset, [[maybe_unused]] std::uint64_t size) const {
+#ifndef _WIN32
+    if (!mData || !fits(offset, size, mSize)) return false;
+    // madvise wants a page aligned start
+    const auto page = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+    const auto start = offset / page * page;
+    return madvise(const_cast<char*>(mData) + start, static_cast<std::size_t>(offset + size - start),
+                   MADV_WILLNEED) == 0;
+#else
+    // read into memory already
+    return true;
+#endif
+  }
+
+  RangeSource::RangeSource(std::shared_ptr<const Source> parent, std::uint64_t offset, std::uint64_t size) {
+    if (!parent || !fits(offset, size, parent->size())) return;
+    if (auto range = dynamic_cast<const RangeSource*>(parent.get())) {
+      offset += range->mOffset;
+      parent = range->mParent;
+    }
+    mParent = std::move(parent);
+    mOffset = offset;
+    mSize = size;
+  }
+  bool RangeSource::read(std::uint64_t offset, char* data, std::size_t size) const {
+    if (!fits(offset, size, mSize)) return false;
+    // an empty range may have no parent at all
+    return size == 0 || mParent->read(mOffset + offset, data, size);
+  }
+  const char* RangeSource::data() const {
+    const char* data = mParent ? mParent->data() : nullptr;
+    return data ? data + mOffset : nullptr;
+  }
+  bool RangeSource::willNeed(std::uint64_t offset, std::uint64_t size) const {
+    return mParent && fits(offset, size, mSize) && mParent->willNeed(mOffset + offset, size);
+  }
+}  // namespace fdb
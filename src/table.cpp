@@ -0,0 +1,267 @@
+#include "base.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "impl/base.hpp"
+#include "impl/table.hpp"
+#include "source.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+  constexpr std::uint32_t EMPTY_SLOT = 0xffffffff;
+
+  template <typename Entry>
+  bool readEntries(const fdb::Source& source, std::uint64_t& offset, std::uint32_t count,
+                   std::vector<fdb::FileTableEntry>& table) {
+    std::vector<Entry> stored(count);
+    if (!source.read(offset, (char*)stored.data(), sizeof(Entry) * count)) return false;
+    offset += sizeof(Entry) * count;
+    table.reserve(count);
+    for (const auto& fte : stored) table.push_back({fte.type, fte.time, fte.offset});
+    return true;
+  }
+  // names are compared with / as separator, in lower case and without leading ./
+  // in place as they only get shorter, returns the new length
+  std::size_t normalize(char* name) {
+    const char* in = name;
+    while (*in == '/' || *in == '\\' || *in == '.') ++in;
+    char* out = name;
+    for (; *in; ++in) {
+      const char c = *in;
+      *out++ = c == '\\' ? '/' : c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+    *out = 0;
+    return out - name;
+  }
+}  // namespace
+
+namespace fdb {
+  namespace impl {
+    Stamp Stamp::of(const char* file) {
+      std::error_code ec;
+      Stamp s;
+      s.size = std::filesystem::file_size(file, ec);
+      if (ec) return {};
+      s.time = std::filesystem::last_write_time(file, ec).time_since_epoch().count();
+      return s;
+    }
+
+    std::size_t Table::layoutSize(std::uint32_t count, std::uint32_t nameBytes) {
+      return sizeof(IndexHeader) + std::size_t(count) * (2 * sizeof(std::uint64_t) + 2 * sizeof(std::uint32_t)) +
+             nameBytes;
+    }
+    void Table::layout(const char* buffer) {
+      const auto& hdr = *reinterpret_cast<const IndexHeader*>(buffer);
+      mCount = hdr.count;
+      mNameBytes = hdr.nameBytes;
+      const char* p = buffer + sizeof(IndexHeader);
+      mEntries = reinterpret_cast<const std::uint64_t*>(p);
+      mTimes = mEntries + mCount;
+      mNameOffsets = reinterpret_cast<const std::uint32_t*>(mTimes + mCount);
+      mSorted = mNameOffsets + mCount;
+      mNames = reinterpret_cast<const char*>(mSorted + mCount);
+    }
+
+    bool Table::read(const Source& source, std::uint64_t offset, Format format, std::uint32_t count) {
+      clear();
+      std::vector<FileTableEntry> table;
+      const bool ok = format == Format::classic ? readEntries<FileTableEntry32>(source, offset, count, table)
+                                                : readEntries<FileTableEntry64>(source, offset, count, table);
+      if (!ok) return false;
+      std::vector<std::uint32_t> len(count);
+      std::uint32_t namelen = 0;
+      const auto lenBytes = count * sizeof(std::uint32_t);
+      if (!source.read(offset, (char*)len.data(), lenBytes) ||
+          !source.read(offset + lenBytes, (char*)&namelen, sizeof(namelen))) {
+        return false;
+      }
+      std::vector<char> stored(namelen + std::size_t(1));
+      if (!source.read(offset + lenBytes + sizeof(namelen), stored.data(), namelen)) return false;
+
+      std::vector<std::uint32_t> starts(count);
+      std::vector<std::uint32_t> lengths(count);
+      for (std::uint32_t i = 0, offset = 0; i < count; ++i) {
+        if (offset >= namelen) return false;
+        starts[i] = offset;
+        lengths[i] = static_cast<std::uint32_t>(normalize(stored.data() + offset));
+        offset += len[i] + 1;
+      }
+      // identical names are kept once, first[i] is the lowest index with the same name
+      // open addressing over the hashes, the slots only ever hold the first of several equal names
+      const char* base = stored.data();
+      std::vector<std::size_t> hashes(count);
+      for (std::uint32_t i = 0; i < count; ++i) {
+        hashes[i] = std::hash<std::string_view>()({base + starts[i], lengths[i]});
+      }
+      std::size_t mask = 1;
+      while (mask < std::size_t(count) * 2) mask <<= 1;
+      std::vector<std::uint32_t> slots(mask--, EMPTY_SLOT);
+      std::vector<std::uint32_t> first(count);
+      std::uint64_t nameBytes = 0;
+      for (std::uint32_t i = 0; i < count; ++i) {
+        for (auto pos = hashes[i] & mask;; pos = (pos + 1) & mask) {
+          const auto other = slots[pos];
+          if (other == EMPTY_SLOT) {
+            slots[pos] = first[i] = i;
+            nameBytes += lengths[i] + 1;
+            break;
+          }
+          if (hashes[other] == hashes[i] && strcmp(base + starts[other], base + starts[i]) == 0) {
+            first[i] = other;
+            break;
+          }
+        }
+      }
+      if (nameBytes >> 32) return false;
+
+      const auto bytes = layoutSize(count, static_cast<std::uint32_t>(nameBytes));
+      mOwned = std::make_unique<std::uint64_t[]>((bytes + 7) / 8);
+      char* buffer = reinterpret_cast<char*>(mOwned.get());
+      IndexHeader hdr{};
+      hdr.count = count;
+      hdr.nameBytes = static_cast<std::uint32_t>(nameBytes);
+      hdr.format = format;
+      memcpy(buffer, &hdr, sizeof(hdr));
+      layout(buffer);
+
+      auto entries = const_cast<std::uint64_t*>(mEntries);
+      auto times = const_cast<std::uint64_t*>(mTimes);
+      auto nameOffsets = const_cast<std::uint32_t*>(mNameOffsets);
+      auto names = const_cast<char*>(mNames);
+      std::uint32_t arena = 0;
+      for (std::uint32_t i = 0; i < count; ++i) {
+        // both share one word, a damaged type must not come back as another one
+        if (table[i].offset > OFFSET_MASK || table[i].type > FileType::image) return clear(), false;
+        entries[i] = table[i].offset | std::uint64_t(table[i].type) << TYPE_SHIFT;
+        times[i] = table[i].time;
+        if (first[i] != i) {
+          nameOffsets[i] = nameOffsets[first[i]];
+          continue;
+        }
+        nameOffsets[i] = arena;
+        memcpy(names + arena, base + starts[i], lengths[i] + 1);
+        arena += lengths[i] + 1;
+      }
+      mBytes = bytes;
+      return true;
+    }
+
+    void Table::sort() const {
+      if (mSortDone.load(std::memory_order_acquire)) return;
+      std::lock_guard<std::mutex> l(mSortLock);
+      if (mSortDone.load(std::memory_order_relaxed)) return;
+      // equal names by index, so find() returns the first of them like a linear search would
+      auto sorted = const_cast<std::uint32_t*>(mSorted);
+      std::iota(sorted, sorted + mCount, 0);
+      std::sort(sorted, sorted + mCount, [&](std::uint32_t a, std::uint32_t b) {
+        if (mNameOffsets[a] == mNameOffsets[b]) return a < b;
+        return strcmp(name(a), name(b)) < 0;
+      });
+      mSortDone.store(true, std::memory_order_release);
+    }
+
+    bool Table::map(const char* index, Format format, std::uint32_t count, const Stamp& archive) {
+      clear();
+#ifndef _WIN32
+      const int fd = ::open(index, O_RDONLY | O_CLOEXEC);
+      if (fd < 0) return false;
+      struct stat st;
+      void* mapping = MAP_FAILED;
+      if (fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) >= sizeof(IndexHeader)) {
+        mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      }
+      ::close(fd);
+      if (mapping == MAP_FAILED) return false;
+      mMapping = mapping;
+      mBytes = static_cast<std::size_t>(st.st_size);
+      const char* buffer = static_cast<const char*>(mapping);
+#else
+      // no shared mapping here, the index still saves parsing and sorting the table
+      std::ifstream f(index, std::ios::binary | std::ios::ate);
+      if (!f) return false;
+      mBytes = static_cast<std::size_t>(f.tellg());
+      if (mBytes < sizeof(IndexHeader)) return false;
+      mOwned = std::make_unique<std::uint64_t[]>((mBytes + 7) / 8);
+      f.seekg(0);
+      if (!f.read(reinterpret_cast<char*>(mOwned.get()), mBytes)) return clear(), false;
+      const char* buffer = reinterpret_cast<const char*>(mOwned.get());
+#endif
+      IndexHeader hdr;
+      memcpy(&hdr, buffer, sizeof(hdr));
+      const bool valid = hdr.magic == INDEX_MAGIC && hdr.version == INDEX_VERSION && hdr.format == format &&
+                         hdr.count == count && hdr.archiveSize == archive.size && hdr.archiveTime == archive.time &&
+                         layoutSize(hdr.count, hdr.nameBytes) == mBytes;
+      if (!valid) return clear(), false;
+      layout(buffer);
+      // a damaged index must not send name() past the arena
+      if (mNameBytes == 0 || mNames[mNameBytes - 1] != 0) return clear(), false;
+      for (std::uint32_t i = 0; i < mCount; ++i) {
+        if (mNameOffsets[i] >= mNameBytes || mSorted[i] >= mCount) return clear(), false;
+      }
+      mSortDone = true;
+      return true;
+    }
+
+    bool Table::save(const char* index, const Stamp& archive) const {
+      if (mCount == 0) return false;
+      sort();
+      // the arrays follow the header in the buffer
+      IndexHeader hdr;
+      memcpy(&hdr, reinterpret_cast<const char*>(mEntries) - sizeof(hdr), sizeof(hdr));
+      hdr.archiveSize = archive.size;
+      hdr.archiveTime = archive.time;
+      // other processes may be writing the same index right now
+      const std::string temp = std::string(index) + "." + std::to_string(std::random_device()()) + ".tmp";
+      bool ok;
+      {
+        std::ofstream f(temp, std::ios::binary | std::ios::trunc);
+        f.write((const char*)&hdr, sizeof(hdr));
+        f.write((const char*)mEntries, layoutSize(mCount, mNameBytes) - sizeof(hdr));
+        ok = static_cast<bool>(f);
+      }
+      std::error_code ec;
+      if (ok) std::filesystem::rename(temp, index, ec);
+      if (ok && !ec) return true;
+      std::filesystem::remove(temp, ec);
+      return false;
+    }
+
+    void Table::clear() {
+#ifndef _WIN32
+      if (mMapping) munmap(mMapping, mBytes);
+#endif
+      mMapping = nullptr;
+      mOwned = nullptr;
+      mBytes = 0;
+      mCount = 0;
+      mNameBytes = 0;
+      mEntries = mTimes = nullptr;
+      mNameOffsets = mSorted = nullptr;
+      mNames = nullptr;
+      mSortDone = false;
+    }
+
+    int Table::find(const char* name) const {
+      sort();
+      const auto end = mSorted + mCount;
+      const auto it = std::lower_bound(mSorted, end, name,
+                                       [&](std::uint32_t i, const char* key) { return strcmp(this->name(i), key) < 0; });
+      if (it == end || strcmp(this->name(*it), name) != 0) return -1;
+      return static_cast<int>(*it);
+    }
+  }  // namespace impl
+}  // namespace fdb
@@ -0,0 +1,137 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+#include "base.hpp"
+#include "impl/base.hpp"
+#include "impl/prefetch.hpp"
+#include "source.hpp"
+
+namespace {
+  constexpr std::uint32_t TRACE_MAGIC = 0x54424446;  // FDBT
+  constexpr std::uint32_t TRACE_VERSION = 1;
+}  // namespace
+
+namespace fdb {
+  bool AccessTrace::save(const char* file) const {
+    std::ofstream f(file, std::ios::binary | std::ios::trunc);
+    if (!f.is_open()) return false;
+    const std::uint64_t count = mRecords.size();
+    f.write((const char*)&TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    f.write((const char*)&TRACE_VERSION, sizeof(TRACE_VERSION));
+    f.write((const char*)&count, sizeof(count));
+    if (count) f.write((const char*)mRecords.data(), count * sizeof(AccessRecord));
+    return static_cast<bool>(f);
+  }
+  bool AccessTrace::load(const char* file) {
+    std::ifstream f(file, std::ios::binary);
+    if (!f.is_open()) return false;
+    std::uint32_t magic = 0, version = 0;
+    std::uint64_t count = 0;
+    f.read((char*)&magic, sizeof(magic));
+    f.read((char*)&version, sizeof(version));
+    f.read((char*)&count, sizeof(count));
+    if (!f || magic != TRACE_MAGIC || version != TRACE_VERSION || count > (1ull << 32)) return false;
+    // a truncated or damaged file must not size the records
+    const auto start = f.tellg();
+    f.seekg(0, std::ios::end);
+    const auto left = static_cast<std::uint64_t>(f.tellg() - start);
+    if (!f || count > left / sizeof(AccessRecord)) return false;
+    f.seekg(start);
+    std::vector<AccessRecord> records(count);
+    if (count && !f.read((char*)records.data(), count * sizeof(AccessRecord))) return false;
+    mRecords = std::move(records);
+    return true;
+  }
+
+  namespace impl {
+    Prefetcher::Prefetcher(std::shared_ptr<const Source> source, Format format, std::vector<Target> targets,
+                           const PrefetchOptions& options)
+        : mOptions(options),
+          mFormat(format),
+          mSource(std::move(source)),
+          mTargets(std::move(targets)),
+          mBytes(mTargets.size()) {
+      std::uint32_t highest = 0;
+      for (std::uint32_t pos = 0; pos < mTargets.size(); ++pos) {
+        mPositions[mTargets[pos].index].push_back(pos);
+        highest = std::max(highest, mTargets[pos].index);
+      }
+      mDone.resize(mTargets.empty() ? 0 : highest + 1);
+      if (mOptions.read) mScratch.resize(1024 * 1024);
+      mThread = std::thread(&Prefetcher::run, this);
+    }
+    Prefetcher::~Prefetcher() {
+      {
+        std::lock_guard<std::mutex> l(mCriticalSection);
+        mStop = true;
+      }
+      mChanged.notify_all();
+      mThread.join();
+    }
+
+    void Prefetcher::accessed(std::uint32_t index) {
+      auto it = mPositions.find(index);
+      if (it == mPositions.end()) return;
+      std::lock_guard<std::mutex> l(mCriticalSection);
+      // the next occurrence after the cursor, accesses that left the trace don't move it
+      auto pos = std::upper_bound(it->second.begin(), it->second.end(), mCursor);
+      if (pos == it->second.end() || *pos > mCursor + 4 * static_cast<std::int64_t>(mOptions.window) + 1) return;
+      for (auto p = mCursor + 1; p <= *pos; ++p) {
+        if (p < static_cast<std::int64_t>(mNext)) mAhead -= mBytes[p];
+      }
+      mCursor = *pos;
+      mChanged.notify_all();
+    }
+
+    void Prefetcher::run() {
+      std::unique_lock<std::mutex> l(mCriticalSection);
+      while (!mStop) {
+        // the reader overtook us, fetching behind it is pointless
+        if (static_cast<std::int64_t>(mNext) <= mCursor) {
+          mNext = static_cast<std::size_t>(mCursor + 1);
+          continue;
+        }
+        if (mNext < mTargets.size() &&
+            static_cast<std::int64_t>(mNext) <= mCursor + static_cast<std::int64_t>(mOptions.window) &&
+            mAhead < mOptions.windowBytes) {
+          const auto pos = mNext++;
+          const auto target = mTargets[pos];
+          if (mDone[target.index]) continue;
+          mDone[target.index] = true;
+          l.unlock();
+          const auto bytes = fetch(target);
+          l.lock();
+          mBytes[pos] = bytes;
+          if (static_cast<std::int64_t>(pos) > mCursor) mAhead += bytes;
+          mIssued += bytes;
+          continue;
+        }
+        mChanged.wait(l);
+      }
+    }
+
+    std::uint64_t Prefetcher::fetch(const Target& target) {
+      NormalFileHeader64 nfh;
+      std::uint64_t offset = target.offset;
+      auto read = [&](char* data, std::size_t size) {
+        if (!mSource->read(offset, data, size)) return false;
+        offset += size;
+        return true;
+      };
+      if (!readHeader(read, mFormat, nfh)) return 0;
+      const std::uint64_t length = (offset - target.offset) + nfh.namelength +
+                                   (target.image ? sizeof(ImageFileHeader) : 0) + payloadSize(nfh);
+      if (!mOptions.read && mSource->willNeed(target.offset, length)) return length;
+      // no advisory interface, reading pulls the pages in just the same
+      if (mScratch.empty()) mScratch.resize(1024 * 1024);
+      for (std::uint64_t done = offset - target.offset; done < length;) {
+        const auto n = static_cast<std::size_t>(std::min<std::uint64_t>(length - done, mScratch.size()));
+        if (!mSource->read(target.offset + done, mScratch.data(), n)) break;
+        done += n;
+      }
+      return length;
+    }
+  }  // namespace impl
+}  // namespace fdb
@@ -0,0 +1,295 @@
+#include "verify.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#include "ImageFile.hpp"
+#include "codec.hpp"
+#include "impl/base.hpp"
+#include "impl/block.hpp"
+#include "impl/zstream.hpp"
+#include "reader.hpp"
+#include "writer.hpp"
+
+namespace {
+  using Problem = fdb::VerifyReport::Problem;
+  using Issue = fdb::VerifyReport::Issue;
+
+  constexpr std::size_t READSIZE = 256 * 1024;
+  constexpr int CHUNK = 16;  // entries a worker takes at once
+
+  struct Extent {
+    std::uint64_t offset;
+    std::uint64_t end;
+    int index;
+  };
+
+  class Worker {
+  public:
+    Worker(const char* file, const fdb::Reader& rd, const fdb::VerifyOptions& options, std::uint64_t fileSize)
+        : mPackage(file, std::ios::binary), mReader(rd), mOptions(options), mFileSize(fileSize) {}
+
+    void check(int index, Extent& extent) {
+      const auto& fte = mReader.entry(index);
+      extent = {fte.offset, fte.offset, index};
+      const auto headerSize = fdb::impl::headerSize(mReader.format());
+      if (fte.offset + headerSize > mFileSize) {
+        return issue(index, Problem::range, "header starts past the end of the file");
+      }
+      fdb::impl::NormalFileHeader64 nfh;
+      // a failed read of the previous entry leaves failbit set
+      mPackage.clear();
+      mPackage.seekg(fte.offset);
+      bool read = true;
+      auto source = [&](char* data, std::size_t size) { return read = static_cast<bool>(mPackage.read(data, size)); };
+      if (!fdb::impl::readHeader(source, mReader.format(), nfh)) {
+        if (!read) return issue(index, Problem::range, "header can't be read");
+        extent.end = fte.offset + headerSize;
+        return issue(index, Problem::header, "header values out of range");
+      }
+      extent.end = fte.offset + headerSize;
+      const bool image = fte.type == fdb::FileType::image;
+      const std::uint64_t data = extent.end + nfh.namelength + (image ? sizeof(fdb::impl::ImageFileHeader) : 0);
+      extent.end = data + fdb::impl::payloadSize(nfh);
+      if (extent.end > mFileSize) {
+        return issue(index, Problem::range, "payload reaches past the end of the file");
+      }
+      mCompressed += fdb::impl::payloadSize(nfh);
+      mUncompressed += nfh.size_uncompressed;
+      if (!mOptions.decompress) return;
+
+      switch (nfh.compression) {
+        case fdb::Compression::none:
+          break;
+        case fdb::Compression::zlib:
+          mPackage.seekg(data);
+          inflate(index, nfh);
+          break;
+        case fdb::Compression::redux:
+          mPackage.seekg(data - (image ? sizeof(fdb::impl::ImageFileHeader) : 0));
+          decode(index, nfh, image);
+          break;
+        case fdb::Compression::zstd:
+        case fdb::Compression::lz4:
+          if (!fdb::available(nfh.compression)) {
+            issue(index, Problem::unsupported, "built without support for compression " +
+                                                   std::to_string((int)nfh.compression));
+            break;
+          }
+          blocks(index, nfh, data);
+          break;
+        default:
+          issue(index, Problem::unsupported, "no decoder for compression " + std::to_string((int)nfh.compression));
+          break;
+      }
+    }
+
+    std::vector<Issue> mIssues;
+    std::uint64_t mCompressed{0};
+    std::uint64_t mUncompressed{0};
+    std::uint32_t mDecompressed{0};
+
+  private:
+    void issue(int index, Problem problem, std::string message) {
+      mIssues.push_back({index, problem, std::move(message)});
+    }
+    void inflate(int index, const fdb::impl::NormalFileHeader64& nfh) {
+      if (!mInflater.reset()) return issue(index, Problem::decompress, "inflateInit failed");
+      std::uint64_t produced = 0;
+      // discarding sink, only counts and stops as soon as the entry turns out too big
+      auto sink = [&](const char*, std::size_t n) {
+        produced += n;
+        return produced <= nfh.size_uncompressed;
+      };
+      mBuffer.resize(READSIZE);
+      auto result = fdb::impl::Inflater::Result::more;
+      std::uint64_t left = nfh.size_compressed;
+      while (left > 0 && result == fdb::impl::Inflater::Result::more) {
+        const auto n = static_cast<std::size_t>(std::min<std::uint64_t>(left, mBuffer.size()));
+        if (!mPackage.read(mBuffer.data(), n)) return issue(index, Problem::range, "payload can't be read");
+        left -= n;
+        result = mInflater.feed(mBuffer.data(), n, sink);
+      }
+      switch (result) {
+        case fdb::impl::Inflater::Result::error:
+          return issue(index, Problem::decompress, "corrupt zlib stream");
+        case fdb::impl::Inflater::Result::stopped:
+          return issue(index, Problem::size, "inflates to more than " + std::to_string(nfh.size_uncompressed));
+        case fdb::impl::Inflater::Result::more:
+          return issue(index, Problem::decompress, "zlib stream is truncated");
+        case fdb::impl::Inflater::Result::end:
+          break;
+      }
+      if (left > 0 || mInflater.pending() > 0) {
+        return issue(index, Problem::decompress, "trailing data after zlib stream");
+      }
+      if (produced != nfh.size_uncompressed) {
+        return issue(index, Problem::size,
+                     std::to_string(produced) + " bytes instead of " + std::to_string(nfh.size_uncompressed));
+      }
+      ++mDecompressed;
+    }
+    void blocks(int index, const fdb::impl::NormalFileHeader64& nfh, std::uint64_t data) {
+      auto source = [&](std::uint64_t at, char* out, std::size_t size) {
+        mPackage.seekg(data + at);
+        return static_cast<bool>(mPackage.read(out, size));
+      };
+      fdb::impl::BlockIndex blockIndex;
+      if (!fdb::impl::readIndex(source, nfh.size_compressed, nfh.size_uncompressed, blockIndex)) {
+        return issue(index, Problem::decompress, "broken block index");
+      }
+      // every block has to decode to exactly its share of the entry
+      if (!fdb::impl::streamBlocks(nfh.compression, source, blockIndex, READSIZE,
+                                   [](const char*, std::size_t) { return true; })) {
+        return issue(index, Problem::decompress, "corrupt block");
+      }
+      ++mDecompressed;
+    }
+    void decode(int index, const fdb::impl::NormalFileHeader64& nfh, bool image) {
+      if (!image) return issue(index, Problem::decompress, "redux payload in a normal entry");
+      auto decoder = fdb::ImageFile::decoder();
+      if (!decoder) return issue(index, Problem::unsupported, "no image decoder installed");
+      if (mDecoder != decoder) {
+        mContext = decoder->context();
+        mDecoder = decoder;
+      }
+      // the decoder takes the whole payload at once
+      if (nfh.size_compressed > fdb::impl::MAX_PACKED_SIZE) {
+        return issue(index, Problem::size, "redux payload of " + std::to_string(nfh.size_compressed) + " bytes");
+      }
+      fdb::ImageFile::Header hdr;
+      mBuffer.resize(static_cast<std::size_t>(nfh.size_compressed));
+      if (!mPackage.read((char*)&hdr, sizeof(hdr)) || !mPackage.read(mBuffer.data(), mBuffer.size())) {
+        return issue(index, Problem::range, "payload can't be read");
+      }
+      if (!decoder->decode(mContext.get(), mBuffer, hdr, mDecoded)) {
+        return issue(index, Problem::decompress, "image decoder failed");
+      }
+      if (mDecoded.size() != nfh.size_uncompressed) {
+        return issue(index, Problem::size,
+                     std::to_string(mDecoded.size()) + " bytes instead of " + std::to_string(nfh.size_uncompressed));
+      }
+      ++mDecompressed;
+    }
+
+    std::ifstream mPackage;
+    const fdb::Reader& mReader;
+    const fdb::VerifyOptions& mOptions;
+    const std::uint64_t mFileSize;
+    fdb::impl::Inflater mInflater;
+    std::vector<char> mBuffer;
+    std::vector<char> mDecoded;
+    std::shared_ptr<const fdb::ImageFile::Decoder> mDecoder;
+    std::unique_ptr<fdb::ImageFile::Decoder::Context> mContext;
+  };
+
+  std::uint64_t tableEnd(const char* file, std::uint32_t count, fdb::Format format) {
+    std::ifstream f(file, std::ios::binary);
+    // the name blob is the last part, its length sits right in front of it
+    f.seekg(fdb::Writer::tableSize(count, 0, format) - sizeof(std::uint32_t));
+    std::uint32_t namelen = 0;
+    f.read((char*)&namelen, sizeof(namelen));
+    return static_cast<std::uint64_t>(f.tellg()) + namelen;
+  }
+}  // namespace
+
+namespace fdb {
+  bool VerifyReport::ok() const {
+    return std::all_of(issues.begin(), issues.end(), [](const auto& i) { return i.problem == Problem::unsupported; });
+  }
+  const char* toString(VerifyReport::Problem problem) {
+    switch (problem) {
+      case Problem::open:
+        return "open";
+      case Problem::header:
+        return "header";
+      case Problem::range:
+        return "range";
+      case Problem::overlap:
+        return "overlap";
+      case Problem::decompress:
+        return "decompress";
+      case Problem::size:
+        return "size";
+      case Problem::unsupported:
+        return "unsupported";
+    }
+    return "unknown";
+  }
+
+  VerifyReport verify(const char* file, const VerifyOptions& options) {
+    const auto start = std::chrono::steady_clock::now();
+    VerifyReport report;
+    Reader rd(file);
+    if (!rd) {
+      report.issues.push_back({-1, Problem::open, "not an fdb archive"});
+      return report;
+    }
+    std::error_code ec;
+    report.fileSize = std::filesystem::file_size(file, ec);
+    report.entries = rd.size();
+
+    // walk the file front to back, every worker takes the next few entries in offset order
+    std::vector<int> order;
+    order.reserve(rd.size());
+    for (std::uint32_t i = 0; i < rd.size(); ++i) {
+      if (rd.entry(i).offset == 0) {
+        ++report.empty;
+      } else {
+        order.push_back(i);
+      }
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return rd.entry(a).offset < rd.entry(b).offset; });
+
+    std::vector<Extent> extents(order.size());
+    std::atomic<std::size_t> next{0};
+    unsigned count = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    count = static_cast<unsigned>(std::max<std::size_t>(1, std::min<std::size_t>(count, order.size() / CHUNK + 1)));
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (unsigned i = 0; i < count; ++i) {
+      workers.push_back(std::make_unique<Worker>(file, rd, options, report.fileSize));
+    }
+    auto run = [&](Worker& w) {
+      for (std::size_t i = next.fetch_add(CHUNK); i < order.size(); i = next.fetch_add(CHUNK)) {
+        for (std::size_t j = i; j < std::min(order.size(), i + CHUNK); ++j) {
+          w.check(order[j], extents[j]);
+        }
+      }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < count; ++i) {
+      threads.emplace_back(run, std::ref(*workers[i]));
+    }
+    run(*workers[0]);
+    for (auto& t : threads) t.join();
+
+    for (auto& w : workers) {
+      report.issues.insert(report.issues.end(), w->mIssues.begin(), w->mIssues.end());
+      report.compressedBytes += w->mCompressed;
+      report.uncompressedBytes += w->mUncompressed;
+      report.decompressed += w->mDecompressed;
+    }
+
+    // extents are already in offset order
+    std::uint64_t end = tableEnd(file, rd.size(), rd.format());
+    int owner = -1;
+    for (const auto& e : extents) {
+      if (e.offset < end) {
+        report.issues.push_back({e.index, Problem::overlap,
+                                 owner < 0 ? "starts inside the file table" : "overlaps entry " + std::to_string(owner)});
+      }
+      if (e.end > end) {
+        end = e.end;
+        owner = e.index;
+      }
+    }
+    std::stable_sort(report.issues.begin(), report.issues.end(),
+                     [](const auto& a, const auto& b) { return a.index < b.index; });
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return report;
+  }
+}  // namespace fdb
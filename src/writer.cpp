@@ -0,0 +1,183 @@
+#include "writer.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+
+#include "ImageFile.hpp"
+#include "codec.hpp"
+#include "impl/base.hpp"
+
+namespace {
+  template <typename Header, typename Entry>
+  void writeTable(std::ostream& out, Header hdr, const std::vector<fdb::FileTableEntry>& table,
+                  const std::vector<std::string>& names, std::uint64_t delta) {
+    hdr.filecount = static_cast<std::uint32_t>(table.size());
+    out.write((char*)&hdr, sizeof(hdr));
+    for (const auto& fte : table) {
+      Entry e{};
+      e.type = fte.type;
+      e.time = fte.time;
+      e.offset = static_cast<decltype(e.offset)>(fte.offset == 0 ? 0 : fte.offset + delta);
+      out.write((char*)&e, sizeof(e));
+    }
+    int namelen = 0;
+    for (const auto& n : names) {
+      int len = static_cast<int>(n.size());
+      out.write((char*)&len, sizeof(len));
+      namelen += len + 1;
+    }
+    out.write((char*)&namelen, sizeof(namelen));
+    for (const auto& n : names) {
+      out.write(n.c_str(), n.size() + 1);
+    }
+  }
+  void writeTable(std::ostream& out, fdb::Format format, const std::vector<fdb::FileTableEntry>& table,
+                  const std::vector<std::string>& names, std::uint64_t delta) {
+    if (format == fdb::Format::extended) {
+      writeTable<fdb::impl::FDBHeader64, fdb::impl::FileTableEntry64>(out, {}, table, names, delta);
+    } else {
+      writeTable<fdb::impl::FDBHeader, fdb::impl::FileTableEntry32>(out, {}, table, names, delta);
+    }
+  }
+  // offsets and sizes of the classic format are 32 bit
+  std::uint64_t limit(fdb::Format format) {
+    return format == fdb::Format::extended ? std::numeric_limits<std::uint64_t>::max()
+                                           : std::numeric_limits<std::uint32_t>::max();
+  }
+}  // namespace
+
+namespace fdb {
+  std::uint64_t Writer::tableSize(std::uint32_t count, std::uint64_t nameBytes, Format format) {
+    if (format == Format::extended) {
+      return sizeof(impl::FDBHeader64) + count * (sizeof(impl::FileTableEntry64) + sizeof(int)) + sizeof(int) +
+             nameBytes;
+    }
+    return sizeof(impl::FDBHeader) + count * (sizeof(impl::FileTableEntry32) + sizeof(int)) + sizeof(int) + nameBytes;
+  }
+
+  bool Writer::open(const char* file, std::uint64_t reserve, Format format) {
+    close();
+    mPackage.open(file, std::ios::binary | std::ios::trunc);
+    if (!mPackage.is_open()) return false;
+    mPath = file;
+    mFormat = format;
+    // offset 0 marks an entry without payload, so no payload may start there
+    mReserve = std::max(reserve, tableSize(0, 0, format));
+    mEnd = mReserve;
+    mPackage.seekp(mEnd);
+    return true;
+  }
+
+  bool Writer::slot(int index, const std::string& name) {
+    if (!mPackage.is_open()) return false;
+    if (index < 0) index = static_cast<int>(mFileTable.size());
+    if (static_cast<std::size_t>(index) >= mFileTable.size()) {
+      mFileTable.resize(index + 1, FileTableEntry{FileType::normal, 0, 0});
+      mFileNames.resize(index + 1);
+    }
+    mFileNames[index] = name;
+    return true;
+  }
+
+  bool Writer::addEmpty(const std::string& name, FileType type, std::uint64_t time, int index) {
+    if (!slot(index, name)) return false;
+    auto& fte = mFileTable[index < 0 ? mFileTable.size() - 1 : index];
+    fte = {type, time, 0};
+    return true;
+  }
+
+  bool Writer::add(const NormalFile& file, int index) { return add(file, file.name(), index); }
+  bool Writer::add(const NormalFile& file, const std::string& name, int index) {
+    const auto& data = file.get();
+    // the format has no entry of size 0, only a table entry without payload
+    if (file.uncompressed_size() == 0) {
+      return data.empty() && addEmpty(name, file.isImage() ? FileType::image : FileType::normal, file.time(), index);
+    }
+    impl::NormalFileHeader64 nfh{};
+    nfh.type = file.isImage() ? FileType::image : FileType::normal;
+    nfh.compression = file.compression();
+    nfh.size_uncompressed = file.uncompressed_size();
+    nfh.size_compressed = file.compression() == Compression::none ? 0 : data.size();
+    nfh.time = file.time();
+    nfh.namelength = static_cast<std::uint32_t>(name.size()) + 1;
+    const std::uint64_t size = impl::headerSize(mFormat) + nfh.namelength +
+                               (file.isImage() ? sizeof(impl::ImageFileHeader) : 0) + data.size();
+    nfh.size = size;
+    if (mEnd + size > limit(mFormat) || nfh.size_uncompressed > limit(mFormat)) return false;
+    // the classic format predates the block codecs, old clients could not read them
+    if (mFormat == Format::classic && blockCompressed(nfh.compression)) return false;
+    if (!slot(index, name)) return false;
+
+    if (mFormat == Format::extended) {
+      mPackage.write((char*)&nfh, sizeof(nfh));
+    } else {
+      impl::NormalFileHeader classic{static_cast<std::uint32_t>(nfh.size),
+                                     nfh.type,
+                                     nfh.compression,
+                                     static_cast<std::uint32_t>(nfh.size_uncompressed),
+                                     static_cast<std::uint32_t>(nfh.size_compressed),
+                                     nfh.time,
+                                     nfh.namelength};
+      mPackage.write((char*)&classic, sizeof(classic));
+    }
+    mPackage.write(name.c_str(), nfh.namelength);
+    if (file.isImage()) {
+      const auto& hdr = static_cast<const ImageFile&>(file).getHeader();
+      impl::ImageFileHeader ifh{hdr.type, hdr.width, hdr.height, hdr.mipmap, {hdr.unk[0], hdr.unk[1], hdr.unk[2]}};
+      mPackage.write((char*)&ifh, sizeof(ifh));
+    }
+    if (!data.empty()) mPackage.write(data.data(), data.size());
+    if (!mPackage) return false;
+
+    mFileTable[index < 0 ? mFileTable.size() - 1 : index] = {nfh.type, nfh.time, mEnd};
+    mEnd += size;
+    return true;
+  }
+
+  bool Writer::close() {
+    if (!mPackage.is_open()) return false;
+    std::uint64_t names = 0;
+    for (const auto& n : mFileNames) names += n.size() + 1;
+    const auto tablesize = tableSize(size(), names, mFormat);
+    bool ok = true;
+    if (tablesize <= mReserve) {
+      mPackage.seekp(0);
+      writeTable(mPackage, mFormat, mFileTable, mFileNames, 0);
+      ok = static_cast<bool>(mPackage);
+      mPackage.close();
+    } else {
+      mPackage.close();
+      ok = relocate(tablesize);
+    }
+    mFileTable.clear();
+    mFileNames.clear();
+    mPath.clear();
+    return ok;
+  }
+
+  bool Writer::relocate(std::uint64_t tablesize) {
+    // the entries have to move back by the part of the table that didn't fit into the reserve
+    const auto delta = tablesize - mReserve;
+    if (mEnd + delta > limit(mFormat)) return false;
+    const auto tmp = mPath + ".tmp";
+    {
+      std::ifstream in(mPath, std::ios::binary);
+      std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+      if (!in.is_open() || !out.is_open()) return false;
+      writeTable(out, mFormat, mFileTable, mFileNames, delta);
+      in.seekg(mReserve);
+      std::vector<char> buffer(1024 * 1024);
+      for (auto left = mEnd - mReserve; left > 0;) {
+        const auto n = static_cast<std::size_t>(std::min<std::uint64_t>(left, buffer.size()));
+        if (!in.read(buffer.data(), n)) return false;
+        out.write(buffer.data(), n);
+        left -= n;
+      }
+      if (!out) return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, mPath, ec);
+    return !ec;
+  }
+}  // namespace fdb
@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "zlib.h"
+
+// writes classic fdb archives byte by byte, independent of the library, and counts failed checks
+namespace test {
+  inline int gFailures = 0;
+  inline void expect(bool condition, const char* what) {
+    if (!condition) {
+      std::cout << "FAIL " << what << std::endl;
+      ++gFailures;
+    }
+  }
+  // result line and exit code of a test
+  inline int finish() {
+    std::cout << (gFailures ? "failed" : "ok") << std::endl;
+    return gFailures ? 1 : 0;
+  }
+
+  struct Entry {
+    std::string name;
+    std::uint32_t type{1};         // FileType
+    std::uint32_t compression{0};  // Compression
+    std::vector<char> payload;     // as stored in the archive
+    std::uint32_t size{0};         // size_uncompressed
+    std::uint32_t image[4]{};      // ImageFileHeader for type 2
+  };
+
+  template <typename T>
+  void put(std::ostream& f, T v) {
+    f.write(reinterpret_cast<const char*>(&v), sizeof(v));
+  }
+
+  inline Entry stored(std::string name, const std::vector<char>& data) {
+    Entry e;
+    e.name = std::move(name);
+    e.payload = data;
+    e.size = static_cast<std::uint32_t>(data.size());
+    return e;
+  }
+  inline Entry zlib(std::string name, const std::vector<char>& data) {
+    Entry e;
+    e.name = std::move(name);
+    e.compression = 3;
+    e.size = static_cast<std::uint32_t>(data.size());
+    uLongf len = compressBound(static_cast<uLong>(data.size()));
+    e.payload.resize(len);
+    compress2((Bytef*)e.payload.data(), &len, (const Bytef*)data.data(), static_cast<uLong>(data.size()), 9);
+    e.payload.resize(len);
+    return e;
+  }
+  inline std::vector<char> pattern(std::size_t size, int seed) {
+    std::vector<char> res(size);
+    for (std::size_t i = 0; i < size; ++i) res[i] = static_cast<char>((i / 7 + seed) * 31);
+    return res;
+  }
+
+  // returns the offset of every entry
+  inline std::vector<std::uint32_t> writeArchive(const char* file, const std::vector<Entry>& entries) {
+    std::ofstream f(file, std::ios::binary);
+    const auto count = static_cast<std::uint32_t>(entries.size());
+    std::uint32_t names = 0;
+    for (const auto& e : entries) names += static_cast<std::uint32_t>(e.name.size()) + 1;
+    std::uint32_t offset = 8 + count * 20 + 4 + names;
+    std::vector<std::uint32_t> offsets;
+    put<std::uint32_t>(f, 0x46444201);
+    put<std::uint32_t>(f, count);
+    for (const auto& e : entries) {
+      offsets.push_back(offset);
+      put<std::uint32_t>(f, e.type);
+      put<std::uint64_t>(f, 0);
+      put<std::uint32_t>(f, offset);
+      offset += 32 + static_cast<std::uint32_t>(e.name.size()) + 1 + (e.type == 2 ? 16 : 0) +
+                static_cast<std::uint32_t>(e.payload.size());
+    }
+    for (const auto& e : entries) put<std::uint32_t>(f, static_cast<std::uint32_t>(e.name.size()));
+    put<std::uint32_t>(f, names);
+    for (const auto& e : entries) f.write(e.name.c_str(), e.name.size() + 1);
+    for (const auto& e : entries) {
+      const auto namelength = static_cast<std::uint32_t>(e.name.size()) + 1;
+      put<std::uint32_t>(f, 32 + namelength + (e.type == 2 ? 16 : 0) + static_cast<std::uint32_t>(e.payload.size()));
+      put<std::uint32_t>(f, e.type);
+      put<std::uint32_t>(f, e.compression);
+      put<std::uint32_t>(f, e.size);
+      put<std::uint32_t>(f, e.compression == 0 ? 0 : static_cast<std::uint32_t>(e.payload.size()));
+      put<std::uint64_t>(f, 0);
+      put<std::uint32_t>(f, namelength);
+      f.write(e.name.c_str(), namelength);
+      if (e.type == 2) f.write(reinterpret_cast<const char*>(e.image), sizeof(e.image));
+      f.write(e.payload.data(), e.payload.size());
+    }
+    return offsets;
+  }
+  // overwrites bytes of an existing file
+  template <typename T>
+  void patch(const char* file, std::uint64_t offset, T v) {
+    std::fstream f(file, std::ios::binary | std::ios::in | std::ios::out);
+    f.seekp(offset);
+    put<T>(f, v);
+  }
+}  // namespace test
@@ -0,0 +1,61 @@
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "fdb/convert.hpp"
+
+namespace {
+  struct Case {
+    fdb::PixelFormat format;
+    const char* name;
+  };
+  const Case gCases[] = {
+      {fdb::PixelFormat::r5g6b5, "r5g6b5"}, {fdb::PixelFormat::a4r4g4b4, "a4r4g4b4"},
+      {fdb::PixelFormat::a1r5g5b5, "a1r5g5b5"}, {fdb::PixelFormat::r8g8b8, "r8g8b8"},
+      {fdb::PixelFormat::bgra8, "bgra8"}, {fdb::PixelFormat::rgba8, "rgba8"},
+      {fdb::PixelFormat::dxt1, "dxt1"}, {fdb::PixelFormat::dxt3, "dxt3"},
+      {fdb::PixelFormat::dxt5, "dxt5"},
+  };
+  const std::uint32_t gSizes[][2] = {{1, 1}, {2, 2}, {4, 4}, {8, 4}, {16, 16}, {64, 32}, {256, 128}};
+  // odd sizes exercise the scalar tails and the partial last blocks of DXT rows and columns
+  const std::uint32_t gOddSizes[][2] = {{3, 5}, {7, 1}, {6, 10}, {13, 9}, {33, 17}};
+}  // namespace
+
+int main() {
+  std::mt19937 rng(42);
+  int failures = 0;
+  auto check = [&](const Case& c, std::uint32_t width, std::uint32_t height) {
+    std::vector<char> src(fdb::levelSize(c.format, width, height));
+    for (auto& b : src) b = static_cast<char>(rng());
+    for (auto target : {fdb::PixelFormat::rgba8, fdb::PixelFormat::bgra8}) {
+      std::vector<char> fast, ref;
+      const bool a = fdb::convert(c.format, src.data(), src.size(), width, height, target, fast);
+      const bool b = fdb::reference::convert(c.format, src.data(), src.size(), width, height, target, ref);
+      if (!a || !b || fast != ref) {
+        std::cout << "FAIL " << c.name << " " << width << "x" << height
+                  << (target == fdb::PixelFormat::bgra8 ? " -> bgra8" : " -> rgba8") << std::endl;
+        ++failures;
+      }
+    }
+  };
+  for (const auto& c : gCases) {
+    for (const auto& s : gSizes) check(c, s[0], s[1]);
+    for (const auto& s : gOddSizes) check(c, s[0], s[1]);
+  }
+
+  // a few fixed values
+  const std::uint16_t white565 = 0xffff;
+  const std::uint16_t red4444 = 0xff00;
+  std::vector<char> out;
+  fdb::convert(fdb::PixelFormat::r5g6b5, &white565, 2, 1, 1, fdb::PixelFormat::rgba8, out);
+  if (out != std::vector<char>{'\xff', '\xff', '\xff', '\xff'}) ++failures, std::cout << "FAIL white565" << std::endl;
+  fdb::convert(fdb::PixelFormat::a4r4g4b4, &red4444, 2, 1, 1, fdb::PixelFormat::bgra8, out);
+  if (out != std::vector<char>{0, 0, '\xff', '\xff'}) ++failures, std::cout << "FAIL red4444" << std::endl;
+  if (fdb::convert(fdb::PixelFormat::dxt1, &white565, 2, 4, 4, fdb::PixelFormat::rgba8, out)) {
+    ++failures, std::cout << "FAIL short input accepted" << std::endl;
+  }
+
+  std::cout << (failures ? "failed" : "ok") << std::endl;
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,85 @@
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "archive.hpp"
+#include "fdb/ImageFile.hpp"
+#include "fdb/reader.hpp"
+
+namespace {
+  class CountingDecoder : public fdb::ImageFile::Decoder {
+  public:
+    std::unique_ptr<Context> context() const override {
+      ++contexts;
+      return std::make_unique<Context>();
+    }
+    bool decode(Context* ctx, const std::vector<char>& in, fdb::ImageFile::Header& hdr,
+                std::vector<char>& out) const override {
+      if (ctx == nullptr) return false;
+      return fdb::storedDecoder()->decode(ctx, in, hdr, out);
+    }
+    mutable std::atomic<int> contexts{0};
+  };
+}  // namespace
+
+int main() {
+  std::vector<char> levels(4 * (64 + 16 + 4 + 1));
+  for (std::size_t i = 0; i < levels.size(); ++i) levels[i] = static_cast<char>(i * 7);
+  // single image entry whose redux payload is just the raw levels
+  test::Entry image;
+  image.name = "texture.dds";
+  image.type = 2;         // FileType::image
+  image.compression = 4;  // Compression::redux
+  image.payload = levels;
+  image.size = static_cast<std::uint32_t>(levels.size());
+  image.image[0] = 4;  // A8R8G8B8
+  image.image[1] = 8;
+  image.image[2] = 8;
+  image.image[3] = 4;  // mipmaps
+  test::writeArchive("decoder_test.fdb", {image});
+
+  fdb::Reader rd("decoder_test.fdb");
+  if (!rd || rd.size() != 1) {
+    std::cout << "FAIL open" << std::endl;
+    return 1;
+  }
+  int failures = 0;
+  if (rd.get(0)->decompress()) {
+    std::cout << "FAIL decoded without a decoder" << std::endl;
+    ++failures;
+  }
+
+  auto decoder = std::make_shared<CountingDecoder>();
+  fdb::ImageFile::decoder(decoder);
+  std::atomic<int> errors{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < 25; ++i) {
+        auto file = rd.get(0);
+        if (!file || !file->isImage() || !file->decompress() || file->get() != levels) {
+          ++errors;
+          continue;
+        }
+        auto all = static_cast<fdb::ImageFile*>(file.get())->levels();
+        if (all.size() != 4 || all[1].width != 4 || all[1].offset != 256 || all[3].size != 4) ++errors;
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  fdb::ImageFile::decoder(nullptr);
+
+  if (errors) {
+    std::cout << "FAIL " << errors << " parallel decodes" << std::endl;
+    ++failures;
+  }
+  if (decoder->contexts != 4) {
+    std::cout << "FAIL expected one context per thread, got " << decoder->contexts << std::endl;
+    ++failures;
+  }
+  std::cout << (failures ? "failed" : "ok") << std::endl;
+  return failures ? 1 : 0;
+}
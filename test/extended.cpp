@@ -0,0 +1,145 @@
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#include "archive.hpp"
+#include "fdb/reader.hpp"
+#include "fdb/repack.hpp"
+#include "fdb/verify.hpp"
+#include "fdb/writer.hpp"
+
+using test::expect;
+
+namespace {
+  std::vector<char> content(const fdb::Reader& rd, int index) {
+    auto file = rd.get(index);
+    if (!file || !file->decompress()) return {};
+    return file->get();
+  }
+  constexpr std::uint64_t GB = 1024ull * 1024 * 1024;
+
+  // extended archive with one stored entry of size bytes, all zero but the last 16, the file stays sparse
+  void writeHuge(const char* file, std::uint64_t size) {
+    std::ofstream f(file, std::ios::binary);
+    const std::string name = "huge.bin";
+    const std::uint64_t offset = 16 + 28 + 4 + name.size() + 1;
+    test::put<std::uint32_t>(f, 0x46444202);
+    test::put<std::uint32_t>(f, 1);  // version
+    test::put<std::uint32_t>(f, 1);  // filecount
+    test::put<std::uint32_t>(f, 0);
+    test::put<std::uint32_t>(f, 1);  // FileType::normal
+    test::put<std::uint32_t>(f, 0);
+    test::put<std::uint64_t>(f, 0);
+    test::put<std::uint64_t>(f, offset);
+    test::put<std::uint32_t>(f, static_cast<std::uint32_t>(name.size()));
+    test::put<std::uint32_t>(f, static_cast<std::uint32_t>(name.size()) + 1);
+    f.write(name.c_str(), name.size() + 1);
+    test::put<std::uint64_t>(f, 48 + name.size() + 1 + size);
+    test::put<std::uint32_t>(f, 1);  // FileType::normal
+    test::put<std::uint32_t>(f, 0);  // Compression::none
+    test::put<std::uint64_t>(f, size);
+    test::put<std::uint64_t>(f, 0);
+    test::put<std::uint64_t>(f, 0);
+    test::put<std::uint32_t>(f, static_cast<std::uint32_t>(name.size()) + 1);
+    test::put<std::uint32_t>(f, 0);
+    f.write(name.c_str(), name.size() + 1);
+    f.seekp(size - 16, std::ios::cur);
+    f.write("0123456789abcdef", 16);
+  }
+}  // namespace
+
+int main() {
+  std::vector<test::Entry> entries;
+  for (int i = 0; i < 8; ++i) {
+    const auto name = "file" + std::to_string(i);
+    const auto data = test::pattern(1000 + i * 997, i);
+    entries.push_back(i % 2 ? test::zlib(name, data) : test::stored(name, data));
+  }
+  test::writeArchive("extended_classic.fdb", entries);
+  fdb::Reader classic("extended_classic.fdb");
+  expect(classic && classic.format() == fdb::Format::classic, "classic archives stay readable");
+
+  // the reserve leaves a hole of 5 GB in front of the entries, so every offset needs more than 32 bits
+  {
+    fdb::Writer wr("extended_sparse.fdb", 5 * GB, fdb::Format::extended);
+    bool added = true;
+    for (std::uint32_t i = 0; i < classic.size(); ++i) added = added && wr.add(*classic.get(i));
+    expect(added && wr.close(), "write extended archive");
+  }
+  {
+    fdb::Writer wr("extended_overflow.fdb", 5 * GB);
+    expect(!wr.add(*classic.get(0)), "classic writer refuses offsets past 4 GB");
+  }
+  std::filesystem::remove("extended_overflow.fdb");
+  {
+    fdb::Reader rd("extended_sparse.fdb");
+    expect(rd && rd.format() == fdb::Format::extended && rd.size() == classic.size(), "open extended archive");
+    expect(rd.entry(0).offset >= 5 * GB, "64 bit offsets");
+    bool same = true;
+    for (std::uint32_t i = 0; i < rd.size(); ++i) {
+      same = same && content(rd, i) == content(classic, i) && rd.info(i).expectedSize == classic.info(i).expectedSize;
+    }
+    expect(same, "contents");
+    std::vector<char> range;
+    const auto third = content(classic, 3);
+    expect(rd.readRange(3, 100, 50, range) && range == std::vector<char>(third.begin() + 100, third.begin() + 150),
+           "ranges past 4 GB");
+    std::uint64_t streamed = 0;
+    expect(rd.stream(5, [&](const char*, std::size_t n) { return (streamed += n) > 0; }) &&
+               streamed == content(classic, 5).size(),
+           "streams past 4 GB");
+    const auto report = fdb::verify("extended_sparse.fdb");
+    expect(report.ok() && report.entries == rd.size(), "verify extended archive");
+  }
+  std::filesystem::remove("extended_sparse.fdb");
+
+  // classic -> extended -> classic
+  fdb::RepackOptions options;
+  options.grouping = fdb::RepackOptions::Grouping::original;
+  options.format = fdb::Format::extended;
+  expect(fdb::repack("extended_classic.fdb", "extended_converted.fdb", options), "convert to extended");
+  options.format = fdb::Format::classic;
+  expect(fdb::repack("extended_converted.fdb", "extended_back.fdb", options), "convert back");
+  {
+    fdb::Reader converted("extended_converted.fdb");
+    fdb::Reader back("extended_back.fdb");
+    expect(converted.format() == fdb::Format::extended && back.format() == fdb::Format::classic, "formats");
+    bool same = true;
+    for (std::uint32_t i = 0; i < classic.size(); ++i) {
+      same = same && content(converted, i) == content(classic, i) && content(back, i) == content(classic, i);
+    }
+    expect(same, "conversion keeps contents");
+  }
+
+  // a single entry over 4 GB, without ever holding it in memory
+  const std::uint64_t huge = 6 * GB + 5;
+  writeHuge("extended_huge.fdb", huge);
+  {
+    fdb::Reader rd("extended_huge.fdb");
+    expect(rd && rd.size() == 1 && rd.info(0).expectedSize == huge, "64 bit sizes");
+    fdb::PayloadLocation location;
+    expect(rd.locate(0, location) && location.size == huge, "locate");
+    std::vector<char> range;
+    expect(rd.readRange(0, huge - 16, 100, range) && std::string(range.begin(), range.end()) == "0123456789abcdef",
+           "tail of a huge entry");
+    expect(rd.readRange(0, 5 * GB, 8, range) && range == std::vector<char>(8, 0), "middle of a huge entry");
+  }
+  std::filesystem::remove("extended_huge.fdb");
+
+  // a header that claims 128 TB passes the sanity limits but not the size of the archive
+  writeHuge("extended_claim.fdb", 1000);
+  test::patch<std::uint64_t>("extended_claim.fdb", 57 + 16, 1ull << 47);
+  {
+    fdb::Reader rd("extended_claim.fdb");
+    fdb::PayloadLocation location;
+    expect(rd && rd.size() == 1 && !rd.get(0) && !rd.source(0) && !rd.locate(0, location),
+           "sizes past the end of the archive");
+    const auto report = fdb::verify("extended_claim.fdb");
+    expect(!report.ok(), "verify reports the claim");
+  }
+  std::filesystem::remove("extended_claim.fdb");
+
+  return test::finish();
+}
@@ -0,0 +1,105 @@
+#include <signal.h>
+#include <sys/wait.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../tools/fdbd/protocol.hpp"
+#include "archive.hpp"
+#include "fdb/NormalFile.hpp"
+#include "fdb/reader.hpp"
+
+using test::expect;
+
+// runs fdbd on a temporary socket, usage: test_fdbd path/to/fdbd path/to/fdbload
+namespace {
+  // long names make a full batch larger than the socket buffer, a server answering before it has read
+  // the whole batch blocks on the client that is still writing it
+  std::string entryName(int i) { return "assets/" + std::string(200, 'x') + "/file" + std::to_string(i) + ".bin"; }
+  std::vector<test::Entry> entries() {
+    std::vector<test::Entry> res;
+    for (int i = 0; i < 8; ++i) {
+      const auto data = test::pattern(i % 2 ? 100000 : 1000 + i, i);
+      res.push_back(i % 3 ? test::stored(entryName(i), data) : test::zlib(entryName(i), data));
+    }
+    return res;
+  }
+  int connectTo(const std::string& path) {
+    sockaddr_un addr;
+    if (!fdbd::address(path, addr)) return -1;
+    for (int attempt = 0; attempt < 100; ++attempt) {
+      const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      if (fd < 0) return -1;
+      if (::connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0) return fd;
+      ::close(fd);
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    return -1;
+  }
+  // one full batch, written completely before the first response is read
+  bool batch(int fd, const fdb::Reader& rd, const std::vector<std::vector<char>>& expected) {
+    std::string out;
+    fdbd::BatchHeader hdr;
+    hdr.count = fdbd::MAX_BATCH;
+    out.append(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    for (std::uint32_t i = 0; i < hdr.count; ++i) {
+      const std::string name = rd.name(i % rd.size());
+      fdbd::Request r{fdbd::Op::get, 0, static_cast<std::uint16_t>(name.size())};
+      out.append(reinterpret_cast<const char*>(&r), sizeof(r));
+      out.append(name.data(), name.size());
+    }
+    if (!fdbd::writeAll(fd, out.data(), out.size())) return false;
+    std::vector<char> data;
+    for (std::uint32_t i = 0; i < hdr.count; ++i) {
+      fdbd::Response r;
+      if (!fdbd::readAll(fd, &r, sizeof(r)) || r.status != fdbd::Status::ok) return false;
+      data.resize(static_cast<std::size_t>(r.length));
+      if (!data.empty() && !fdbd::readAll(fd, data.data(), data.size())) return false;
+      if (data != expected[i % rd.size()]) return false;
+    }
+    return true;
+  }
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc != 3) return 2;
+  test::writeArchive("fdbd_test.fdb", entries());
+  fdb::Reader rd("fdbd_test.fdb");
+  expect(rd && rd.size() == 8, "open");
+  std::vector<std::vector<char>> expected;
+  for (std::uint32_t i = 0; i < rd.size(); ++i) {
+    auto file = rd.get(i);
+    expect(file && file->decompress(), "get");
+    expected.push_back(file ? file->get() : std::vector<char>());
+  }
+
+  const std::string socket = "fdbd_test." + std::to_string(::getpid()) + ".sock";
+  const pid_t server = ::fork();
+  if (server == 0) {
+    ::execl(argv[1], argv[1], "-s", socket.c_str(), "fdbd_test.fdb", static_cast<char*>(nullptr));
+    std::_Exit(127);
+  }
+  expect(server > 0, "start fdbd");
+
+  const int fd = server > 0 ? connectTo(socket) : -1;
+  expect(fd >= 0, "connect");
+  if (fd >= 0) {
+    expect(batch(fd, rd, expected), "full batch matches Reader::get()");
+    expect(batch(fd, rd, expected), "second batch on the same connection");
+    ::close(fd);
+  }
+  const std::string load = std::string(argv[2]) + " -s " + socket + " -c 4 -n 2000 -b 64 > /dev/null";
+  expect(fd >= 0 && std::system(load.c_str()) == 0, "fdbload without errors");
+
+  if (server > 0) {
+    ::kill(server, SIGTERM);
+    int status = 0;
+    ::waitpid(server, &status, 0);
+  }
+  ::unlink(socket.c_str());
+  return test::finish();
+}
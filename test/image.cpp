@@ -0,0 +1,105 @@
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "archive.hpp"
+#include "fdb/ImageFile.hpp"
+#include "fdb/reader.hpp"
+
+using test::expect;
+
+namespace {
+  // stored image entry, the payload is the raw levels of every face
+  test::Entry image(std::string name, std::uint32_t type, std::uint32_t width, std::uint32_t height,
+                    std::uint32_t mipmap, std::size_t bytes) {
+    auto e = test::stored(std::move(name), test::pattern(bytes, static_cast<int>(type)));
+    e.type = 2;
+    e.image[0] = type;
+    e.image[1] = width;
+    e.image[2] = height;
+    e.image[3] = mipmap;
+    return e;
+  }
+  bool is(const fdb::ImageFile::Level& l, std::uint32_t width, std::uint32_t height, std::uint32_t pitch,
+          std::size_t offset, std::size_t size) {
+    return l.width == width && l.height == height && l.pitch == pitch && l.offset == offset && l.size == size;
+  }
+}  // namespace
+
+int main() {
+  // 8x8 A8R8G8B8 with 4 levels: 256 + 64 + 16 + 4 bytes
+  // 4x2 A8R8G8B8 with 4 levels, the last two are clamped to 1x1
+  // 8x8 DXT1 with 3 levels, DXT levels never get smaller than one 4x4 block
+  // 4x4 A8R8G8B8 cubemap with 2 levels, six faces of 64 + 16 bytes
+  test::writeArchive("image_test.fdb", {image("rgba.dds", 4, 8, 8, 4, 340), image("small.dds", 4, 4, 2, 4, 48),
+                                        image("dxt1.dds", 5, 8, 8, 3, 48), image("cube.dds", 4, 4, 4, 2, 6 * 80),
+                                        image("unknown.dds", 9, 4, 4, 1, 64)});
+  fdb::Reader rd("image_test.fdb");
+  expect(rd.size() == 5, "open");
+  auto get = [&](const char* name) {
+    auto file = rd.get(rd.index(name));
+    return std::unique_ptr<fdb::ImageFile>(file && file->isImage() ? static_cast<fdb::ImageFile*>(file.release())
+                                                                    : nullptr);
+  };
+
+  if (auto img = get("rgba.dds")) {
+    const auto all = img->levels();
+    expect(img->faces() == 1 && all.size() == 4, "rgba levels");
+    expect(all.size() == 4 && is(all[0], 8, 8, 32, 0, 256) && is(all[1], 4, 4, 16, 256, 64) &&
+               is(all[2], 2, 2, 8, 320, 16) && is(all[3], 1, 1, 4, 336, 4),
+           "rgba offsets and sizes");
+    const auto l = img->level(2);
+    expect(is(l, 2, 2, 8, 320, 16) && l.data == img->get().data() + 320, "rgba level");
+    expect(all.size() == 4 && all[3].data == img->get().data() + 336, "level data");
+  } else {
+    expect(false, "rgba entry");
+  }
+
+  if (auto img = get("small.dds")) {
+    const auto all = img->levels();
+    expect(all.size() == 4 && is(all[0], 4, 2, 16, 0, 32) && is(all[1], 2, 1, 8, 32, 8) &&
+               is(all[2], 1, 1, 4, 40, 4) && is(all[3], 1, 1, 4, 44, 4),
+           "levels are clamped to 1x1");
+  } else {
+    expect(false, "small entry");
+  }
+
+  if (auto img = get("dxt1.dds")) {
+    const auto all = img->levels();
+    expect(all.size() == 3 && is(all[0], 8, 8, 16, 0, 32) && is(all[1], 4, 4, 8, 32, 8) &&
+               is(all[2], 2, 2, 8, 40, 8),
+           "dxt levels are at least one block");
+  } else {
+    expect(false, "dxt1 entry");
+  }
+
+  if (auto img = get("cube.dds")) {
+    expect(img->faces() == 6 && img->levels().size() == 12, "cubemap faces");
+    const auto l = img->level(1, 3);
+    expect(l.face == 3 && l.level == 1 && is(l, 2, 2, 8, 3 * 80 + 64, 16), "cubemap level");
+    expect(img->level(0, 5).data == img->get().data() + 5 * 80, "last face");
+    const auto past = img->level(0, 6);
+    const auto deep = img->level(2);
+    expect(past.data == nullptr && past.size == 0 && past.width == 0, "face out of range");
+    expect(deep.data == nullptr && deep.size == 0 && deep.offset == 0, "level out of range");
+  } else {
+    expect(false, "cube entry");
+  }
+
+  // dds files only exist for the formats above, the rest is refused instead of written without a header
+  if (auto img = get("unknown.dds")) {
+    expect(!img->toFile("image_unknown.dds"), "unknown pixel format");
+  } else {
+    expect(false, "unknown entry");
+  }
+  if (auto img = get("dxt1.dds")) {
+    expect(img->toFile("image_dxt1.dds") && std::filesystem::file_size("image_dxt1.dds") == 128 + 48, "dds file");
+    expect(!img->toFile("image_missing/dxt1.dds"), "unwritable file");
+  }
+  std::filesystem::remove("image_dxt1.dds");
+  std::filesystem::remove("image_test.fdb");
+  return test::finish();
+}
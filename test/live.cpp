@@ -0,0 +1,86 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "archive.hpp"
+#include "fdb/live.hpp"
+
+using test::expect;
+
+namespace {
+  // patches arrive the way they should, written next to the archive and renamed over it
+  void publish(int version) {
+    std::vector<test::Entry> entries;
+    for (int i = 0; i < 16; ++i) {
+      entries.push_back(test::stored("file" + std::to_string(i), test::pattern(100 + i, version)));
+    }
+    entries.push_back(test::stored("version", std::vector<char>(1, static_cast<char>(version))));
+    test::writeArchive("live_test.fdb.new", entries);
+    std::rename("live_test.fdb.new", "live_test.fdb");
+  }
+  int version(const fdb::Reader& rd) {
+    auto file = rd.get(rd.index("version"));
+    return file && file->get().size() == 1 ? file->get()[0] : -1;
+  }
+}  // namespace
+
+int main() {
+  publish(1);
+  fdb::LiveReader live("live_test.fdb");
+  expect(live && live.generation() == 1, "open");
+  auto pinned = live.snapshot();
+
+  publish(2);
+  expect(live.reload() && live.generation() == 2, "reload");
+  expect(version(*live.snapshot()) == 2, "new snapshot");
+  expect(version(*pinned) == 1, "pinned snapshot keeps reading the old file");
+  pinned.reset();
+
+  // readers keep going while patches roll in underneath them
+  std::atomic<bool> stop{false};
+  std::atomic<int> errors{0};
+  std::atomic<int> reloads{0};
+  expect(live.watch([&](bool ok) {
+    if (!ok) ++errors;
+    ++reloads;
+  }),
+         "watch");
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&] {
+      while (!stop) {
+        auto rd = live.snapshot();
+        const int v = version(*rd);
+        for (std::uint32_t i = 0; i + 1 < rd->size(); ++i) {
+          auto file = rd->get(i);
+          if (!file || file->get() != test::pattern(100 + i, v)) ++errors;
+        }
+      }
+    });
+  }
+  for (int v = 3; v <= 6; ++v) {
+    publish(v);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (version(*live.snapshot()) != v && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    expect(version(*live.snapshot()) == v, "watcher picks up the patch");
+  }
+  stop = true;
+  for (auto& t : threads) t.join();
+  live.unwatch();
+  expect(errors == 0, "reads during reloads");
+  expect(reloads >= 4, "callback");
+
+  // a broken patch leaves the last good snapshot in place
+  std::ofstream("live_test.fdb.new", std::ios::binary).put('x');
+  std::rename("live_test.fdb.new", "live_test.fdb");
+  expect(!live.reload() && version(*live.snapshot()) == 6, "failed reload keeps the snapshot");
+
+  return test::finish();
+}
@@ -0,0 +1,70 @@
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "archive.hpp"
+#include "fdb/reader.hpp"
+
+using test::expect;
+
+namespace {
+  // small alphabet without long repeats, so deflate emits plenty of blocks
+  std::vector<char> text(std::size_t size) {
+    std::vector<char> res(size);
+    std::mt19937 rng(7);
+    for (auto& c : res) c = static_cast<char>('a' + rng() % 16);
+    return res;
+  }
+  bool slice(const fdb::Reader& rd, int index, const std::vector<char>& data, std::uint64_t offset,
+             std::size_t length) {
+    std::vector<char> out;
+    if (!rd.readRange(index, offset, length, out)) return false;
+    const auto begin = std::min<std::uint64_t>(offset, data.size());
+    const auto end = std::min<std::uint64_t>(offset + length, data.size());
+    return out == std::vector<char>(data.begin() + begin, data.begin() + end);
+  }
+}  // namespace
+
+int main() {
+  const auto data = text(2 * 1024 * 1024);
+  test::writeArchive("range_test.fdb", {test::stored("stored.bin", data), test::zlib("zlib.bin", data)});
+
+  fdb::Reader rd("range_test.fdb");
+  if (!rd || rd.size() != 2) {
+    std::cout << "FAIL open" << std::endl;
+    return 1;
+  }
+  for (int index : {0, 1}) {
+    expect(slice(rd, index, data, 0, 64), "head");
+    expect(slice(rd, index, data, 1000000, 5000), "middle");
+    expect(slice(rd, index, data, data.size() - 100, 1000), "clipped at the end");
+    expect(slice(rd, index, data, data.size() + 10, 10), "past the end");
+  }
+
+  rd.checkpoints(64 * 1024);
+  expect(slice(rd, 1, data, data.size() - 10, 10), "tail with checkpoints");
+  std::atomic<int> errors{0};
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t] {
+      std::mt19937 rng(t);
+      for (int i = 0; i < 50; ++i) {
+        const auto offset = rng() % data.size();
+        if (!slice(rd, 1, data, offset, 1 + rng() % 70000)) ++errors;
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  expect(errors == 0, "ranges resumed from checkpoints");
+
+  rd.startTrace();
+  std::vector<char> out;
+  expect(rd.readRange(1, 10, 20, out), "traced range");
+  auto trace = rd.stopTrace();
+  expect(trace.size() == 1 && trace.records()[0].bytes == 20, "ranges are traced");
+
+  return test::finish();
+}
@@ -0,0 +1,132 @@
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "archive.hpp"
+#include "fdb/reader.hpp"
+#include "fdb/repack.hpp"
+#include "fdb/verify.hpp"
+#include "fdb/writer.hpp"
+
+using test::expect;
+
+namespace {
+  std::vector<char> content(const fdb::Reader& rd, int index) {
+    auto file = rd.get(index);
+    if (!file || !file->decompress()) return {};
+    return file->get();
+  }
+  std::vector<char> bytes(const char* file) {
+    std::ifstream f(file, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(f), {});
+  }
+}  // namespace
+
+int main() {
+  // directories interleaved on purpose
+  std::vector<test::Entry> entries;
+  for (int i = 0; i < 60; ++i) {
+    const auto name = "dir" + std::to_string(i % 4) + "/file" + std::to_string(i) + (i % 3 ? ".bin" : ".txt");
+    const auto data = test::pattern(200 + i * 301, i);
+    entries.push_back(i % 2 ? test::zlib(name, data) : test::stored(name, data));
+  }
+  test::writeArchive("repack_source.fdb", entries);
+  fdb::Reader src("repack_source.fdb");
+
+  fdb::RepackOptions options;
+  options.trace = {"dir3/file59.bin", "dir0/file4.bin", "missing/file", "dir3/file59.bin"};
+  options.grouping = fdb::RepackOptions::Grouping::directory;
+  options.memoryLimit = 4096;  // forces the pipeline to stall on nearly every entry
+  fdb::RepackStats stats;
+  expect(fdb::repack("repack_source.fdb", "repack_target.fdb", options, &stats), "repack");
+  expect(stats.entries == 60, "stats");
+  expect(fdb::verify("repack_target.fdb").ok(), "verify target");
+
+  {
+    fdb::Reader dst("repack_target.fdb");
+    expect(dst.size() == src.size(), "entry count");
+    bool same = true;
+    for (std::uint32_t i = 0; i < src.size(); ++i) {
+      same = same && std::string(src.name(i)) == dst.name(i) && content(src, i) == content(dst, i) &&
+             src.info(i).compression == dst.info(i).compression;
+    }
+    expect(same, "indices, names and contents are kept");
+
+    // traced entries first, then one contiguous run per directory
+    const auto order = fdb::repackOrder(src, options);
+    expect(order[0] == 59 && order[1] == 4, "trace order");
+    bool ascending = true;
+    for (std::size_t i = 1; i < order.size(); ++i) {
+      ascending = ascending && dst.entry(order[i - 1]).offset < dst.entry(order[i]).offset;
+    }
+    expect(ascending, "payloads follow the repack order");
+    int runs = 0;
+    for (std::size_t i = 2; i < order.size(); ++i) {
+      if (i == 2 || std::string(dst.name(order[i])).substr(0, 4) != std::string(dst.name(order[i - 1])).substr(0, 4))
+        ++runs;
+    }
+    expect(runs == 4, "directories are contiguous");
+  }
+
+  options = {};
+  options.recompress = true;
+  options.threads = 3;
+  expect(fdb::repack("repack_source.fdb", "repack_zlib.fdb", options, &stats), "recompress");
+  expect(stats.recompressed == 60, "recompressed count");
+  {
+    fdb::Reader dst("repack_zlib.fdb");
+    bool same = true;
+    for (std::uint32_t i = 0; i < src.size(); ++i) {
+      same = same && dst.info(i).compression == fdb::Compression::zlib && content(src, i) == content(dst, i);
+    }
+    expect(same, "recompressed contents");
+  }
+  expect(!fdb::repack("repack_source.fdb", "repack_source.fdb"), "in place repack is refused");
+
+  // names as stored and image headers with their unknown bytes, in the original order nothing changes at all
+  test::Entry image = test::stored("Textures\\Stone.DDS", test::pattern(4 * 8 * 8, 7));
+  image.type = 2;
+  image.image[0] = 4;
+  image.image[1] = 8;
+  image.image[2] = 8;
+  image.image[3] = 1 | 0xabcdef00;  // mipmap and unk[3]
+  const auto offsets = test::writeArchive(
+      "repack_names.fdb", {test::stored("./Data\\Mixed\\File.TXT", {'a', 'b'}), image, test::zlib("UPPER.BIN", {'c'})});
+  options = {};
+  options.grouping = fdb::RepackOptions::Grouping::original;
+  expect(fdb::repack("repack_names.fdb", "repack_names_out.fdb", options), "repack names");
+  expect(bytes("repack_names.fdb") == bytes("repack_names_out.fdb"), "repack in the original order is byte exact");
+  {
+    fdb::Reader rd("repack_names_out.fdb");
+    const auto stored = rd.storedNames();
+    expect(stored.size() == 3 && stored[0] == "./Data\\Mixed\\File.TXT" && stored[2] == "UPPER.BIN", "stored names");
+  }
+
+  // an entry whose header is damaged fails the repack instead of coming out empty
+  test::patch<std::uint32_t>("repack_names.fdb", offsets[2] + 12, 0);
+  expect(!fdb::repack("repack_names.fdb", "repack_names_out.fdb", options), "damaged entry fails the repack");
+
+  // an empty file is written the way the reader expects it, as an entry without payload
+  {
+    std::ofstream("repack_empty.txt", std::ios::binary);
+    std::ofstream("repack_full.txt", std::ios::binary) << "xy";
+    fdb::NormalFile empty;
+    fdb::NormalFile full;
+    fdb::Writer wr("repack_empty.fdb");
+    expect(empty.fromFile("repack_empty.txt", "empty.txt") && full.fromFile("repack_full.txt", "full.txt") &&
+               wr.add(empty) && wr.add(full) && wr.close(),
+           "write an empty file");
+  }
+  {
+    fdb::Reader rd("repack_empty.fdb");
+    expect(rd.size() == 2 && rd.entry(0).offset == 0 && !rd.get(0) && rd.info(0).expectedSize == 0 &&
+               content(rd, 1) == std::vector<char>{'x', 'y'},
+           "empty file reads back as an empty entry");
+    expect(fdb::verify("repack_empty.fdb").ok(), "verify an empty file");
+  }
+  expect(fdb::repack("repack_empty.fdb", "repack_empty_out.fdb", options), "repack an empty file");
+
+  return test::finish();
+}
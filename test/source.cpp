@@ -0,0 +1,124 @@
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "archive.hpp"
+#include "fdb/NormalFile.hpp"
+#include "fdb/reader.hpp"
+#include "fdb/source.hpp"
+
+using test::expect;
+
+namespace {
+  std::vector<char> load(const char* file) {
+    std::ifstream f(file, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(f), {});
+  }
+  std::vector<test::Entry> entries() {
+    return {test::stored("a.txt", test::pattern(1000, 1)), test::zlib("dir\\b.bin", test::pattern(300000, 2)),
+            test::stored("empty.txt", {})};
+  }
+  // the entries above, whatever the archive was opened from
+  bool same(const fdb::Reader& rd) {
+    if (rd.size() != 3) return false;
+    const auto a = rd.get(rd.index("a.txt"));
+    const auto b = rd.get(rd.index("dir/b.bin"));
+    if (!a || !b || !b->decompress()) return false;
+    if (a->get() != test::pattern(1000, 1) || b->get() != test::pattern(300000, 2)) return false;
+    std::vector<char> range;
+    const std::vector<char> expected(b->get().begin() + 200000, b->get().begin() + 200010);
+    if (!rd.readRange(1, 200000, 10, range) || range != expected) return false;
+    std::vector<char> streamed;
+    const bool ok = rd.stream(1, [&](const char* data, std::size_t size) {
+      streamed.insert(streamed.end(), data, data + size);
+      return true;
+    });
+    return ok && streamed == b->get();
+  }
+}  // namespace
+
+int main() {
+  test::writeArchive("source_inner.fdb", entries());
+  const auto bytes = load("source_inner.fdb");
+
+  expect(same(fdb::Reader(std::make_shared<fdb::MemorySource>(bytes.data(), bytes.size()))), "borrowed memory");
+  expect(same(fdb::Reader(std::make_shared<fdb::MemorySource>(bytes))), "owned memory");
+  auto mapped = std::make_shared<fdb::MappedSource>("source_inner.fdb");
+  expect(*mapped && mapped->size() == bytes.size() && same(fdb::Reader(mapped)), "mapped file");
+  auto file = std::make_shared<fdb::FileSource>("source_inner.fdb");
+  expect(*file && same(fdb::Reader(file)), "file");
+#ifndef _WIN32
+  {
+    const int fd = ::open("source_inner.fdb", O_RDONLY);
+    auto source = std::make_shared<fdb::FileSource>(fd);
+    ::close(fd);
+    expect(*source && same(fdb::Reader(source)), "file descriptor");
+  }
+#endif
+
+  // an archive in the middle of a container file
+  {
+    std::ofstream f("source_container.bin", std::ios::binary);
+    f << std::string(100, 'x');
+    f.write(bytes.data(), bytes.size());
+    f << std::string(50, 'y');
+  }
+  auto container = std::make_shared<fdb::FileSource>("source_container.bin");
+  expect(same(fdb::Reader(std::make_shared<fdb::RangeSource>(container, 100, bytes.size()))), "range of a file");
+  expect(!fdb::Reader(std::make_shared<fdb::RangeSource>(container, 0, bytes.size())), "range at the wrong place");
+  expect(fdb::RangeSource(container, 200, container->size()).size() == 0, "range past the end is empty");
+  auto outer = std::make_shared<fdb::RangeSource>(container, 50, bytes.size() + 50);
+  auto inner = std::make_shared<fdb::RangeSource>(outer, 50, bytes.size());
+  expect(same(fdb::Reader(inner)), "range of a range");
+
+  // nested archives, stored ones are read straight from the parent's mapping
+  test::writeArchive("source_outer.fdb", {test::stored("first.txt", {'1'}), test::stored("inner.fdb", bytes),
+                                          test::zlib("packed.fdb", bytes)});
+  {
+    auto parent = std::make_unique<fdb::Reader>(std::make_shared<fdb::MappedSource>("source_outer.fdb"));
+    auto stored = parent->source(parent->index("inner.fdb"));
+    auto packed = parent->source(parent->index("packed.fdb"));
+    expect(stored && stored->data() && memcmp(stored->data(), bytes.data(), bytes.size()) == 0,
+           "stored entry is a view of the parent");
+    expect(packed && packed->size() == bytes.size(), "compressed entry is decompressed");
+    parent->close();
+    expect(stored && same(fdb::Reader(stored)), "nested archive outlives its parent");
+    expect(packed && same(fdb::Reader(packed)), "compressed nested archive");
+  }
+
+  // entries are read without taking turns
+  {
+    fdb::Reader rd(file);
+    std::vector<std::thread> threads;
+    std::vector<int> good(4);
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&, t] {
+        for (int i = 0; i < 20; ++i) good[t] += same(rd);
+      });
+    }
+    for (auto& t : threads) t.join();
+    expect(good == std::vector<int>(4, 20), "concurrent reads");
+  }
+
+  expect(!fdb::Reader(std::shared_ptr<const fdb::Source>()), "no source");
+  expect(!fdb::Reader(std::make_shared<fdb::MemorySource>(bytes.data(), 6)), "truncated header");
+  expect(!fdb::Reader(std::make_shared<fdb::MemorySource>(bytes.data(), 40)), "truncated table");
+  expect(!fdb::MappedSource("source_missing.fdb") && !fdb::FileSource("source_missing.fdb"), "missing file");
+
+  std::filesystem::remove("source_inner.fdb");
+  std::filesystem::remove("source_outer.fdb");
+  std::filesystem::remove("source_container.bin");
+  return test::finish();
+}
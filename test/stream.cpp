@@ -0,0 +1,51 @@
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "archive.hpp"
+#include "fdb/reader.hpp"
+
+using test::expect;
+
+int main() {
+  const auto data = test::pattern(8 * 1024 * 1024 + 123, 3);
+  const auto expected = crc32(0, (const Bytef*)data.data(), static_cast<uInt>(data.size()));
+  auto rle = test::stored("rle.bin", {1, 2, 3});
+  rle.compression = 1;
+  test::writeArchive("stream_test.fdb", {test::stored("stored.bin", data), test::zlib("zlib.bin", data), rle});
+
+  fdb::Reader rd("stream_test.fdb");
+  if (!rd || rd.size() != 3) {
+    std::cout << "FAIL open" << std::endl;
+    return 1;
+  }
+  const std::size_t buffer = 16 * 1024;
+  for (int index : {0, 1}) {
+    uLong crc = 0;
+    std::uint64_t total = 0;
+    std::size_t largest = 0;
+    const bool ok = rd.stream(index,
+                              [&](const char* p, std::size_t n) {
+                                crc = crc32(crc, (const Bytef*)p, static_cast<uInt>(n));
+                                total += n;
+                                largest = std::max(largest, n);
+                                return true;
+                              },
+                              buffer);
+    expect(ok && total == data.size() && crc == expected, index ? "zlib entry" : "stored entry");
+    expect(largest <= buffer, "chunks fit the buffer");
+  }
+
+  std::uint64_t seen = 0;
+  expect(!rd.stream(1,
+                    [&](const char*, std::size_t n) {
+                      seen += n;
+                      return seen < 100000;
+                    },
+                    buffer),
+         "sink stops the stream");
+  expect(seen < 2 * 100000, "nothing is inflated after the sink stopped");
+  expect(!rd.stream(2, [](const char*, std::size_t) { return true; }), "entries that can't be decoded fail");
+
+  return test::finish();
+}
@@ -0,0 +1,98 @@
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "archive.hpp"
+#include "fdb/reader.hpp"
+
+using test::expect;
+
+namespace {
+  void write(int files) {
+    std::vector<test::Entry> entries;
+    for (int i = 0; i < files; ++i) {
+      entries.push_back(test::stored("Data\\Dir" + std::to_string(i % 7) + "\\File" + std::to_string(i) + ".bin",
+                                     test::pattern(10 + i, i)));
+    }
+    // the same name twice after normalizing, lookups return the first one
+    entries.push_back(test::stored("./data/dup.txt", {'1'}));
+    entries.push_back(test::stored("DATA\\DUP.TXT", {'2'}));
+    test::writeArchive("table_test.fdb", entries);
+  }
+  bool same(const fdb::Reader& a, const fdb::Reader& b) {
+    if (a.size() != b.size()) return false;
+    for (std::uint32_t i = 0; i < a.size(); ++i) {
+      const auto ea = a.entry(i);
+      const auto eb = b.entry(i);
+      if (std::string(a.name(i)) != b.name(i) || ea.offset != eb.offset || ea.type != eb.type) return false;
+      if (b.index(b.name(i)) != a.index(a.name(i))) return false;
+    }
+    return true;
+  }
+}  // namespace
+
+int main() {
+  write(100);
+  std::filesystem::remove("table_test.idx");
+  fdb::Reader plain("table_test.fdb");
+  expect(plain && plain.size() == 102 && !plain.sharedTable(), "open without index");
+  expect(std::string(plain.name(0)) == "data/dir0/file0.bin", "names are normalized");
+  expect(plain.index("data/dir3/file10.bin") == 10 && plain.index("data/dir3/file11.bin") == -1, "index");
+  expect(plain.index("data/dup.txt") == 100, "first of two equal names");
+  expect(plain.name(100) == plain.name(101), "equal names are stored once");
+  std::size_t nameBytes = 0;
+  for (std::uint32_t i = 0; i < 101; ++i) nameBytes += strlen(plain.name(i)) + 1;
+  expect(plain.tableBytes() == 40 + 102 * 24 + nameBytes, "24 bytes per entry and the names");
+
+  {
+    fdb::Reader first("table_test.fdb", "table_test.idx");
+    expect(std::filesystem::exists("table_test.idx") && first.sharedTable(), "index is written and mapped");
+    expect(same(plain, first), "mapped table");
+    fdb::Reader second("table_test.fdb", "table_test.idx");
+    expect(second.sharedTable() && same(plain, second), "index is reused");
+    auto file = second.get(second.index("data/dup.txt"));
+    expect(file && file->get() == std::vector<char>{'1'}, "entries through a mapped table");
+  }
+
+  // a changed archive makes the index stale, it is rebuilt
+  write(120);
+  {
+    fdb::Reader changed("table_test.fdb");
+    fdb::Reader rd("table_test.fdb", "table_test.idx");
+    expect(rd.size() == 122 && rd.sharedTable() && same(changed, rd), "stale index is rebuilt");
+  }
+
+  // garbage is never mapped
+  {
+    std::fstream f("table_test.idx", std::ios::binary | std::ios::in | std::ios::out);
+    f.seekp(-3, std::ios::end);
+    f.write("xyz", 3);
+  }
+  {
+    fdb::Reader rd("table_test.fdb", "table_test.idx");
+    fdb::Reader changed("table_test.fdb");
+    expect(rd && same(changed, rd), "broken index is replaced");
+  }
+  std::filesystem::resize_file("table_test.idx", 100);
+  {
+    fdb::Reader rd("table_test.fdb", "table_test.idx");
+    expect(rd.size() == 122 && rd.sharedTable(), "truncated index is replaced");
+  }
+  std::filesystem::remove("table_test.idx");
+
+  // the type shares a word with the offset, one that doesn't fit is a damaged table
+  test::writeArchive("table_type.fdb", {test::stored("a.txt", {'a'})});
+  test::patch<std::uint32_t>("table_type.fdb", 8, 0x102);
+  expect(!fdb::Reader("table_type.fdb"), "type past the packed byte");
+  test::patch<std::uint32_t>("table_type.fdb", 8, 3);
+  expect(!fdb::Reader("table_type.fdb"), "unknown type");
+  test::patch<std::uint32_t>("table_type.fdb", 8, 1);
+  expect(fdb::Reader("table_type.fdb").size() == 1, "known type");
+  std::filesystem::remove("table_type.fdb");
+
+  return test::finish();
+}
@@ -0,0 +1,78 @@
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "archive.hpp"
+#include "fdb/reader.hpp"
+
+using test::expect;
+
+int main() {
+  std::vector<test::Entry> entries;
+  for (int i = 0; i < 32; ++i) {
+    entries.push_back(test::zlib("file" + std::to_string(i), test::pattern(1000 + i * 50, i)));
+  }
+  test::writeArchive("trace_test.fdb", entries);
+
+  const std::vector<int> order = {5, 3, 9, 9, 20, 1, 31, 0, 12, 7};
+  fdb::AccessTrace trace;
+  {
+    fdb::Reader rd("trace_test.fdb");
+    rd.startTrace();
+    for (auto i : order) {
+      auto file = rd.get(i);
+    }
+    expect(rd.info(2).expectedSize == entries[2].size, "info while tracing");
+    trace = rd.stopTrace();
+    auto untraced = rd.get(4);
+  }
+  expect(trace.size() == order.size() + 1, "record count");
+  bool indices = true;
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    indices = indices && trace.records()[i].index == static_cast<std::uint32_t>(order[i]) &&
+              trace.records()[i].bytes == entries[order[i]].payload.size();
+  }
+  expect(indices, "recorded indices and bytes");
+  expect(trace.records().back().index == 2 && trace.records().back().bytes == 0, "info is recorded");
+  expect(trace.records().front().time <= trace.records().back().time, "timestamps");
+
+  expect(trace.save("trace_test.trc"), "save");
+  fdb::AccessTrace loaded;
+  expect(loaded.load("trace_test.trc") && loaded.size() == trace.size() &&
+             loaded.records()[4].index == trace.records()[4].index,
+         "load");
+  expect(!loaded.load("trace_test.fdb"), "reject foreign files");
+  std::filesystem::resize_file("trace_test.trc", std::filesystem::file_size("trace_test.trc") - 1);
+  expect(!loaded.load("trace_test.trc") && loaded.size() == trace.size(), "reject truncated files");
+  test::patch<std::uint64_t>("trace_test.trc", 8, 1ull << 32);
+  expect(!loaded.load("trace_test.trc"), "reject counts past the end of the file");
+
+  // the first window is fetched right away, the rest follows the accesses
+  fdb::PrefetchOptions options;
+  options.window = 4;
+  for (bool read : {false, true}) {
+    options.read = read;
+    fdb::Reader rd("trace_test.fdb");
+    expect(rd.prefetch(trace, options), "prefetch");
+    auto wait = [&](std::uint64_t atLeast) {
+      for (int i = 0; i < 200 && rd.prefetched() < atLeast; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      }
+      return rd.prefetched();
+    };
+    const auto first = wait(1);
+    expect(first > 0, "first window");
+    for (auto i : order) {
+      auto file = rd.get(i);
+      expect(file && file->decompress() && file->get() == test::pattern(1000 + i * 50, i), "content");
+    }
+    expect(wait(first + 1) > first, "prefetch follows the reader");
+    rd.close();
+    expect(rd.prefetched() == 0, "close stops prefetching");
+  }
+
+  return test::finish();
+}
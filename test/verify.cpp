@@ -0,0 +1,91 @@
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#include "archive.hpp"
+#include "fdb/ImageFile.hpp"
+#include "fdb/verify.hpp"
+
+using test::expect;
+
+namespace {
+  bool has(const fdb::VerifyReport& report, int index, fdb::VerifyReport::Problem problem) {
+    for (const auto& i : report.issues) {
+      if (i.index == index && i.problem == problem) return true;
+    }
+    return false;
+  }
+}  // namespace
+
+int main() {
+  std::vector<test::Entry> entries;
+  int compressed = 0;
+  for (int i = 0; i < 40; ++i) {
+    // some entries span several read chunks
+    const auto data = test::pattern(i % 5 == 0 ? 700 * 1024 + i : 100 + i * 97, i);
+    const auto name = "dir" + std::to_string(i % 3) + "/file" + std::to_string(i) + ".bin";
+    if (i % 2) {
+      entries.push_back(test::zlib(name, data));
+      ++compressed;
+    } else {
+      entries.push_back(test::stored(name, data));
+    }
+  }
+  const auto offsets = test::writeArchive("verify_test.fdb", entries);
+
+  fdb::VerifyOptions options;
+  options.threads = 4;
+  auto report = fdb::verify("verify_test.fdb", options);
+  expect(report.ok() && report.issues.empty(), "clean archive");
+  expect(report.entries == 40, "entry count");
+  expect(report.decompressed == static_cast<std::uint32_t>(compressed), "decompressed count");
+  expect(report.fileSize == std::filesystem::file_size("verify_test.fdb"), "file size");
+
+  // entry 3 claims one byte more than its stream inflates to
+  test::patch<std::uint32_t>("verify_test.fdb", offsets[3] + 12, entries[3].size + 1);
+  // entry 5 is moved into the middle of entry 4
+  test::patch<std::uint32_t>("verify_test.fdb", 8 + 5 * 16 + 12, offsets[4] + 40);
+  // entry 8 points past the end of the file
+  test::patch<std::uint32_t>("verify_test.fdb", 8 + 8 * 16 + 12, static_cast<std::uint32_t>(report.fileSize) + 10);
+  // a few bytes of entry 9's stream are damaged
+  test::patch<std::uint64_t>("verify_test.fdb", offsets[9] + 32 + entries[9].name.size() + 1 + 10, ~0ull);
+
+  report = fdb::verify("verify_test.fdb", options);
+  expect(!report.ok(), "damaged archive");
+  expect(has(report, 3, fdb::VerifyReport::Problem::size), "size mismatch");
+  expect(has(report, 5, fdb::VerifyReport::Problem::overlap) || has(report, 5, fdb::VerifyReport::Problem::header),
+         "overlap");
+  expect(has(report, 8, fdb::VerifyReport::Problem::range), "range");
+  expect(has(report, 9, fdb::VerifyReport::Problem::decompress) || has(report, 9, fdb::VerifyReport::Problem::size),
+         "corrupt stream");
+  expect(!has(report, 10, fdb::VerifyReport::Problem::size), "untouched entry");
+
+  // redux images through the stored decoder, the second one claims more than it decodes to
+  std::vector<test::Entry> images;
+  for (int i = 0; i < 2; ++i) {
+    test::Entry image;
+    image.name = "image" + std::to_string(i) + ".dds";
+    image.type = 2;
+    image.compression = 4;
+    image.payload = test::pattern(4 * 16 * 16, i);
+    image.size = static_cast<std::uint32_t>(image.payload.size()) + i * 4;
+    image.image[0] = 4;
+    image.image[1] = 16;
+    image.image[2] = 16;
+    image.image[3] = 1;
+    images.push_back(image);
+  }
+  test::writeArchive("verify_redux.fdb", images);
+  fdb::ImageFile::decoder(fdb::storedDecoder());
+  report = fdb::verify("verify_redux.fdb", options);
+  fdb::ImageFile::decoder(nullptr);
+  expect(report.decompressed == 1 && !has(report, 0, fdb::VerifyReport::Problem::size), "redux image");
+  expect(has(report, 1, fdb::VerifyReport::Problem::size), "redux size mismatch");
+  std::filesystem::remove("verify_redux.fdb");
+
+  report = fdb::verify("does_not_exist.fdb");
+  expect(has(report, -1, fdb::VerifyReport::Problem::open), "missing archive");
+
+  return test::finish();
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+
+// command line helpers shared by the tools
+namespace tools {
+  // positive decimal number up to max, anything else is a usage error and leaves value as it was
+  template <typename T>
+  bool positive(const char* text, T& value, std::uint64_t max = std::numeric_limits<T>::max()) {
+    if (*text < '0' || *text > '9') return false;
+    char* end = nullptr;
+    errno = 0;
+    const auto v = std::strtoull(text, &end, 10);
+    if (errno != 0 || *end != 0 || v == 0 || v > max || v > std::numeric_limits<T>::max()) return false;
+    value = static_cast<T>(v);
+    return true;
+  }
+}  // namespace tools
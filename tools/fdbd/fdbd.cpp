@@ -0,0 +1,297 @@
+#include <fcntl.h>
+#include <sys/sendfile.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../args.hpp"
+#include "fdb/reader.hpp"
+#include "protocol.hpp"
+
+// serves entries of a set of archives to local processes over a unix domain socket
+namespace {
+  struct Archive {
+    std::string path;
+    std::unique_ptr<fdb::Reader> reader;
+    int fd{-1};  // separate handle for sendfile, the reader keeps its own
+  };
+  struct Location {
+    std::uint32_t archive;
+    std::uint32_t index;
+  };
+
+  // decompressed entries, least recently used are dropped first
+  class Cache {
+  public:
+    using Data = std::shared_ptr<const std::vector<char>>;
+    explicit Cache(std::size_t limit) : mLimit(limit) {}
+
+    Data find(std::uint64_t key) {
+      std::lock_guard<std::mutex> l(mCriticalSection);
+      auto it = mMap.find(key);
+      if (it == mMap.end()) return nullptr;
+      mEntries.splice(mEntries.begin(), mEntries, it->second);
+      return it->second->second;
+    }
+    void insert(std::uint64_t key, Data data) {
+      if (data->size() > mLimit) return;
+      std::lock_guard<std::mutex> l(mCriticalSection);
+      if (mMap.count(key)) return;
+      mBytes += data->size();
+      mEntries.emplace_front(key, std::move(data));
+      mMap[key] = mEntries.begin();
+      while (mBytes > mLimit) {
+        mBytes -= mEntries.back().second->size();
+        mMap.erase(mEntries.back().first);
+        mEntries.pop_back();
+      }
+    }
+
+  private:
+    std::mutex mCriticalSection;
+    std::list<std::pair<std::uint64_t, Data>> mEntries;
+    std::unordered_map<std::uint64_t, decltype(mEntries)::iterator> mMap;
+    std::size_t mBytes{0};
+    const std::size_t mLimit;
+  };
+
+  class Server {
+  public:
+    explicit Server(std::size_t cacheSize) : mCache(cacheSize) {}
+    ~Server() {
+      for (auto& a : mArchives) {
+        if (a.fd >= 0) ::close(a.fd);
+      }
+    }
+
+    bool add(const char* path) {
+      Archive a;
+      a.path = path;
+      a.reader = std::make_unique<fdb::Reader>(path);
+      a.fd = ::open(path, O_RDONLY | O_CLOEXEC);
+      if (!*a.reader || a.fd < 0) {
+        if (a.fd >= 0) ::close(a.fd);
+        return false;
+      }
+      // later archives override earlier ones, the same way patches do
+      const auto archive = static_cast<std::uint32_t>(mArchives.size());
+      for (std::uint32_t i = 0; i < a.reader->size(); ++i) {
+        mIndex[a.reader->name(i)] = {archive, i};
+      }
+      mArchives.push_back(std::move(a));
+      return true;
+    }
+    void finish() {
+      mNames.reserve(mIndex.size());
+      for (const auto& it : mIndex) mNames.push_back(it.first);
+      std::sort(mNames.begin(), mNames.end());
+    }
+    std::size_t entries() const { return mIndex.size(); }
+
+    // the whole batch is read before anything is answered, a client that writes its batch before reading
+    // would otherwise block on a full socket while the server blocks on sending it the first payloads
+    void serve(int client) {
+      struct Pending {
+        fdbd::Request request;
+        std::string name;
+      };
+      std::vector<Pending> batch;
+      std::string out;
+      for (;;) {
+        fdbd::BatchHeader hdr;
+        if (!fdbd::readAll(client, &hdr, sizeof(hdr))) break;
+        if (hdr.magic != fdbd::MAGIC || hdr.count > fdbd::MAX_BATCH) break;
+        batch.resize(hdr.count);
+        bool ok = true;
+        for (auto& p : batch) {
+          ok = fdbd::readAll(client, &p.request, sizeof(p.request));
+          if (!ok) break;
+          p.name.resize(p.request.length);
+          ok = p.name.empty() || fdbd::readAll(client, p.name.data(), p.name.size());
+          if (!ok) break;
+        }
+        for (std::size_t i = 0; i < batch.size() && ok; ++i) {
+          const auto& p = batch[i];
+          switch (p.request.op) {
+            case fdbd::Op::get:
+              ok = get(client, out, p.name, p.request.flags);
+              break;
+            case fdbd::Op::info:
+              info(out, p.name);
+              break;
+            case fdbd::Op::list:
+              list(out, p.name);
+              break;
+            default:
+              respond(out, fdbd::Status::badRequest);
+              break;
+          }
+        }
+        // all small responses of a batch leave in one write
+        if (!ok || !flush(client, out)) break;
+      }
+      ::close(client);
+    }
+
+  private:
+    void respond(std::string& out, fdbd::Status status, std::uint64_t length = 0, std::uint32_t compression = 0,
+                 std::uint64_t expectedSize = 0) {
+      fdbd::Response r{status, compression, expectedSize, length};
+      out.append(reinterpret_cast<const char*>(&r), sizeof(r));
+    }
+    bool flush(int client, std::string& out) {
+      const bool ok = out.empty() || fdbd::writeAll(client, out.data(), out.size());
+      out.clear();
+      return ok;
+    }
+    const Location* find(const std::string& name) const {
+      auto it = mIndex.find(name);
+      return it == mIndex.end() ? nullptr : &it->second;
+    }
+
+    bool get(int client, std::string& out, const std::string& name, std::uint8_t flags) {
+      const auto* loc = find(name);
+      if (!loc) {
+        respond(out, fdbd::Status::notFound);
+        return true;
+      }
+      const auto& archive = mArchives[loc->archive];
+      fdb::PayloadLocation payload;
+      if (!archive.reader->locate(loc->index, payload)) {
+        respond(out, fdbd::Status::error);
+        return true;
+      }
+      if (payload.compression == fdb::Compression::none || (flags & fdbd::raw)) {
+        // zero copy straight from the page cache into the socket
+        respond(out, fdbd::Status::ok, payload.size, static_cast<std::uint32_t>(payload.compression),
+                payload.expectedSize);
+        return flush(client, out) && sendFile(client, archive.fd, payload.offset, payload.size);
+      }
+      const std::uint64_t key = (std::uint64_t(loc->archive) << 32) | loc->index;
+      auto data = mCache.find(key);
+      if (!data) {
+        auto file = archive.reader->get(loc->index);
+        if (!file || !file->decompress()) {
+          respond(out, fdbd::Status::error);
+          return true;
+        }
+        data = std::make_shared<const std::vector<char>>(file->get());
+        mCache.insert(key, data);
+      }
+      respond(out, fdbd::Status::ok, data->size(), 0, data->size());
+      return flush(client, out) && (data->empty() || fdbd::writeAll(client, data->data(), data->size()));
+    }
+    void info(std::string& out, const std::string& name) {
+      const auto* loc = find(name);
+      if (!loc) return respond(out, fdbd::Status::notFound);
+      const auto& archive = mArchives[loc->archive];
+      fdb::PayloadLocation payload;
+      if (!archive.reader->locate(loc->index, payload)) return respond(out, fdbd::Status::error);
+      fdbd::Info info{archive.reader->entry(loc->index).time, static_cast<std::uint32_t>(payload.compression),
+                      loc->archive, payload.size, payload.expectedSize};
+      respond(out, fdbd::Status::ok, sizeof(info));
+      out.append(reinterpret_cast<const char*>(&info), sizeof(info));
+    }
+    void list(std::string& out, const std::string& prefix) {
+      std::string names;
+      for (auto it = std::lower_bound(mNames.begin(), mNames.end(), std::string_view(prefix));
+           it != mNames.end() && it->substr(0, prefix.size()) == prefix; ++it) {
+        names.append(it->data(), it->size());
+        names.push_back('\n');
+      }
+      respond(out, fdbd::Status::ok, names.size());
+      out += names;
+    }
+    static bool sendFile(int client, int fd, std::uint64_t offset, std::uint64_t size) {
+      auto off = static_cast<off_t>(offset);
+      while (size > 0) {
+        const auto n = ::sendfile(client, fd, &off, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        size -= static_cast<std::uint64_t>(n);
+      }
+      return true;
+    }
+
+    std::vector<Archive> mArchives;
+    std::unordered_map<std::string_view, Location> mIndex;  // views into the readers' name tables
+    std::vector<std::string_view> mNames;                   // sorted, for prefix listings
+    Cache mCache;
+  };
+
+  char gSocketPath[sizeof(sockaddr_un::sun_path)];
+  extern "C" void onSignal(int) {
+    ::unlink(gSocketPath);
+    std::_Exit(0);
+  }
+
+  int usage() {
+    std::cerr << "usage: fdbd [-s socket] [--cache MB] archive..." << std::endl;
+    return 2;
+  }
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string socketPath = fdbd::DEFAULT_SOCKET;
+  std::size_t cache = 256;
+  int first = 1;
+  for (; first < argc && argv[first][0] == '-'; ++first) {
+    if (!strcmp(argv[first], "-s") && first + 1 < argc) {
+      socketPath = argv[++first];
+    } else if (!strcmp(argv[first], "--cache") && first + 1 < argc) {
+      if (!tools::positive(argv[++first], cache, std::numeric_limits<std::size_t>::max() >> 20)) return usage();
+    } else {
+      return usage();
+    }
+  }
+  if (first == argc) return usage();
+
+  Server server(cache * 1024 * 1024);
+  for (int i = first; i < argc; ++i) {
+    if (!server.add(argv[i])) {
+      std::cerr << "fdbd: can't open " << argv[i] << std::endl;
+      return 1;
+    }
+  }
+  server.finish();
+
+  sockaddr_un addr;
+  if (!fdbd::address(socketPath, addr)) return usage();
+  const int listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  ::unlink(socketPath.c_str());
+  if (listener < 0 || ::bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(listener, 128) != 0) {
+    std::cerr << "fdbd: can't listen on " << socketPath << ": " << strerror(errno) << std::endl;
+    return 1;
+  }
+  memcpy(gSocketPath, addr.sun_path, sizeof(gSocketPath));
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+  std::signal(SIGPIPE, SIG_IGN);
+  std::cout << "fdbd: " << server.entries() << " entries from " << (argc - first) << " archives on " << socketPath
+            << std::endl;
+
+  for (;;) {
+    const int client = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    std::thread(&Server::serve, &server, client).detach();
+  }
+  ::close(listener);
+  ::unlink(socketPath.c_str());
+  return 1;
+}
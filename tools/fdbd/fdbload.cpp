@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../args.hpp"
+#include "protocol.hpp"
+
+// load test for fdbd: random batched gets from several connections, reports latency percentiles
+namespace {
+  using Clock = std::chrono::steady_clock;
+
+  struct Options {
+    std::string socket{fdbd::DEFAULT_SOCKET};
+    std::string prefix;
+    unsigned connections{4};
+    std::uint64_t requests{10000};
+    std::uint32_t batch{16};
+    std::uint8_t flags{0};
+  };
+
+  int connectTo(const std::string& path) {
+    sockaddr_un addr;
+    if (!fdbd::address(path, addr)) return -1;
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && ::connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+      ::close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  void append(std::string& out, fdbd::Op op, std::uint8_t flags, const std::string& name) {
+    fdbd::Request r{op, flags, static_cast<std::uint16_t>(name.size())};
+    out.append(reinterpret_cast<const char*>(&r), sizeof(r));
+    out += name;
+  }
+
+  bool receive(int fd, fdbd::Response& r, std::vector<char>& data) {
+    if (!fdbd::readAll(fd, &r, sizeof(r))) return false;
+    data.resize(static_cast<std::size_t>(r.length));
+    return data.empty() || fdbd::readAll(fd, data.data(), data.size());
+  }
+
+  bool list(const Options& options, std::vector<std::string>& names) {
+    const int fd = connectTo(options.socket);
+    if (fd < 0) return false;
+    std::string out;
+    fdbd::BatchHeader hdr;
+    hdr.count = 1;
+    out.append(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    append(out, fdbd::Op::list, 0, options.prefix);
+    fdbd::Response r;
+    std::vector<char> data;
+    const bool ok = fdbd::writeAll(fd, out.data(), out.size()) && receive(fd, r, data) &&
+                    r.status == fdbd::Status::ok;
+    ::close(fd);
+    if (!ok) return false;
+    for (std::size_t start = 0, end; (end = std::find(data.begin() + start, data.end(), '\n') - data.begin()) <
+                                     data.size();
+         start = end + 1) {
+      names.emplace_back(data.data() + start, end - start);
+    }
+    return true;
+  }
+
+  struct Result {
+    std::vector<std::uint32_t> latencies;  // microseconds, per request
+    std::uint64_t bytes{0};
+    std::uint64_t errors{0};
+  };
+
+  // every response's latency is measured from sending its batch to having read it completely
+  void run(const Options& options, const std::vector<std::string>& names, std::uint64_t requests, unsigned seed,
+           Result& res) {
+    const int fd = connectTo(options.socket);
+    if (fd < 0) {
+      res.errors += requests;
+      return;
+    }
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<std::size_t> pick(0, names.size() - 1);
+    std::string out;
+    std::vector<char> data;
+    res.latencies.reserve(static_cast<std::size_t>(requests));
+    while (requests > 0) {
+      const auto count = static_cast<std::uint32_t>(std::min<std::uint64_t>(requests, options.batch));
+      out.clear();
+      fdbd::BatchHeader hdr;
+      hdr.count = count;
+      out.append(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+      for (std::uint32_t i = 0; i < count; ++i) append(out, fdbd::Op::get, options.flags, names[pick(rng)]);
+
+      const auto start = Clock::now();
+      if (!fdbd::writeAll(fd, out.data(), out.size())) break;
+      for (std::uint32_t i = 0; i < count; ++i) {
+        fdbd::Response r;
+        if (!receive(fd, r, data)) {
+          res.errors += requests;
+          ::close(fd);
+          return;
+        }
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+        res.latencies.push_back(static_cast<std::uint32_t>(us));
+        res.bytes += data.size();
+        if (r.status != fdbd::Status::ok) ++res.errors;
+      }
+      requests -= count;
+    }
+    res.errors += requests;
+    ::close(fd);
+  }
+
+  std::uint32_t percentile(const std::vector<std::uint32_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    return sorted[std::min(sorted.size() - 1, static_cast<std::size_t>(p * sorted.size()))];
+  }
+
+  int usage() {
+    std::cerr << "usage: fdbload [-s socket] [-c connections] [-n requests] [-b batch] [--raw] [--prefix p]"
+              << std::endl;
+    return 2;
+  }
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool value = i + 1 < argc;
+    if (arg == "-s" && value) {
+      options.socket = argv[++i];
+    } else if (arg == "-c" && value) {
+      if (!tools::positive(argv[++i], options.connections, 1024)) return usage();
+    } else if (arg == "-n" && value) {
+      if (!tools::positive(argv[++i], options.requests)) return usage();
+    } else if (arg == "-b" && value) {
+      if (!tools::positive(argv[++i], options.batch, fdbd::MAX_BATCH)) return usage();
+    } else if (arg == "--prefix" && value) {
+      options.prefix = argv[++i];
+    } else if (arg == "--raw") {
+      options.flags |= fdbd::raw;
+    } else {
+      return usage();
+    }
+  }
+  if (options.connections == 0 || options.batch == 0 || options.batch > fdbd::MAX_BATCH) return usage();
+
+  std::vector<std::string> names;
+  if (!list(options, names)) {
+    std::cerr << "fdbload: can't reach fdbd on " << options.socket << std::endl;
+    return 1;
+  }
+  if (names.empty()) {
+    std::cerr << "fdbload: no entries" << std::endl;
+    return 1;
+  }
+
+  std::vector<Result> results(options.connections);
+  std::vector<std::thread> threads;
+  const auto start = Clock::now();
+  for (unsigned c = 0; c < options.connections; ++c) {
+    const auto share = options.requests / options.connections + (c < options.requests % options.connections);
+    threads.emplace_back(run, std::cref(options), std::cref(names), share, c + 1, std::ref(results[c]));
+  }
+  for (auto& t : threads) t.join();
+  const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  Result total;
+  for (const auto& r : results) {
+    total.latencies.insert(total.latencies.end(), r.latencies.begin(), r.latencies.end());
+    total.bytes += r.bytes;
+    total.errors += r.errors;
+  }
+  std::sort(total.latencies.begin(), total.latencies.end());
+  const auto done = total.latencies.size();
+  std::cout << done << " requests over " << options.connections << " connections in batches of " << options.batch
+            << ", " << total.errors << " errors" << std::endl;
+  std::cout << seconds << " s, " << (done / seconds) << " req/s, " << (total.bytes / seconds / (1024 * 1024))
+            << " MB/s" << std::endl;
+  std::cout << "latency us: p50 " << percentile(total.latencies, 0.5) << ", p99 " << percentile(total.latencies, 0.99)
+            << ", max " << (done ? total.latencies.back() : 0) << std::endl;
+  return total.errors ? 1 : 0;
+}
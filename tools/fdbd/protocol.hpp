@@ -0,0 +1,81 @@
+#pragma once
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// wire format between fdbd and its clients, native byte order since both sides share a host
+//
+// client: BatchHeader, then count times Request followed by length bytes of name (or prefix for list)
+// server: for every request, in order, Response followed by length bytes of data
+namespace fdbd {
+  constexpr std::uint32_t MAGIC = 0x51424446;  // FDBQ
+  constexpr const char* DEFAULT_SOCKET = "/tmp/fdbd.sock";
+  constexpr std::uint32_t MAX_BATCH = 4096;
+
+  enum class Op : std::uint8_t { get = 1, info = 2, list = 3 };
+  enum Flags : std::uint8_t {
+    raw = 1  // get: send the payload as stored instead of decompressing it
+  };
+  enum class Status : std::uint32_t { ok, notFound, error, badRequest };
+
+#pragma pack(push, 4)
+  struct BatchHeader {
+    std::uint32_t magic{MAGIC};
+    std::uint32_t count;
+  };
+  struct Request {
+    Op op;
+    std::uint8_t flags;
+    std::uint16_t length;
+  };
+  struct Response {
+    Status status;
+    std::uint32_t compression;  // of the data that follows
+    std::uint64_t expectedSize;
+    std::uint64_t length;
+  };
+  // data of an info response
+  struct Info {
+    std::uint64_t time;
+    std::uint32_t compression;
+    std::uint32_t archive;
+    std::uint64_t storedSize;
+    std::uint64_t expectedSize;
+  };
+#pragma pack(pop)
+
+  inline bool readAll(int fd, void* data, std::size_t size) {
+    auto* p = static_cast<char*>(data);
+    while (size > 0) {
+      const auto n = ::read(fd, p, size);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return false;
+      p += n;
+      size -= static_cast<std::size_t>(n);
+    }
+    return true;
+  }
+  inline bool writeAll(int fd, const void* data, std::size_t size) {
+    auto* p = static_cast<const char*>(data);
+    while (size > 0) {
+      const auto n = ::send(fd, p, size, MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return false;
+      p += n;
+      size -= static_cast<std::size_t>(n);
+    }
+    return true;
+  }
+  inline bool address(const std::string& path, sockaddr_un& addr) {
+    if (path.size() >= sizeof(addr.sun_path)) return false;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+  }
+}  // namespace fdbd
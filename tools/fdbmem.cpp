@@ -0,0 +1,156 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#include "args.hpp"
+#include "fdb/reader.hpp"
+#include "fdb/writer.hpp"
+
+// memory benchmark for the reader table: opens the same synthetic archive many times, like every worker
+// holding all archives of a client, and reports what the tables cost per entry
+namespace {
+  using Clock = std::chrono::steady_clock;
+
+  struct Options {
+    std::uint32_t entries{1000000};
+    unsigned archives{40};
+    bool index{false};
+    std::string dir{std::filesystem::temp_directory_path().string()};
+  };
+
+  int usage() {
+    std::cerr << "usage: fdbmem [-n entries] [-a archives] [--index] [--dir path]" << std::endl;
+    return 2;
+  }
+
+  // resident and shared bytes of this process, 0 where that isn't known
+  struct Memory {
+    std::uint64_t resident{0};
+    std::uint64_t shared{0};
+    std::uint64_t owned() const { return resident - shared; }
+  };
+  Memory memory() {
+    Memory m;
+#ifdef __linux__
+    std::ifstream f("/proc/self/statm");
+    std::uint64_t size = 0;
+    f >> size >> m.resident >> m.shared;
+    const auto page = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+    m.resident *= page;
+    m.shared *= page;
+#endif
+    return m;
+  }
+
+  // names shaped like a client's: a few directory levels, mixed case and backslashes
+  std::string name(std::uint32_t i) {
+    static const char* dirs[] = {"Interface\\Icons\\", "Model\\Character\\", "Model\\Item\\", "Sound\\Effect\\",
+                                 "Scene\\Terrain\\", "Data\\"};
+    return std::string(dirs[i % 6]) + "Group" + std::to_string(i / 1000) + "\\Entry_" + std::to_string(i) + ".dat";
+  }
+
+  bool generate(const std::string& file, std::uint32_t entries) {
+    fdb::Writer wr(file.c_str());
+    for (std::uint32_t i = 0; i < entries; ++i) {
+      if (!wr.addEmpty(name(i), fdb::FileType::normal, i)) return false;
+    }
+    return wr.close();
+  }
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const bool hasValue = i + 1 < argc;
+    if (!strcmp(argv[i], "-n") && hasValue) {
+      if (!tools::positive(argv[++i], options.entries)) return usage();
+    } else if (!strcmp(argv[i], "-a") && hasValue) {
+      if (!tools::positive(argv[++i], options.archives)) return usage();
+    } else if (!strcmp(argv[i], "--index")) {
+      options.index = true;
+    } else if (!strcmp(argv[i], "--dir") && hasValue) {
+      options.dir = argv[++i];
+    } else {
+      return usage();
+    }
+  }
+  if (options.entries == 0 || options.archives == 0) return usage();
+
+  const auto archive = (std::filesystem::path(options.dir) / "fdbmem_bench.fdb").string();
+  const auto index = archive + ".idx";
+  if (!generate(archive, options.entries)) {
+    std::cerr << "can't write " << archive << std::endl;
+    return 1;
+  }
+  std::filesystem::remove(index);
+  if (options.index) {
+    // written once up front, the way the first worker to start would
+    fdb::Reader first(archive.c_str(), index.c_str());
+  }
+
+  const auto before = memory();
+  const auto start = Clock::now();
+  std::vector<std::unique_ptr<fdb::Reader>> readers;
+  std::uint64_t table = 0;
+  for (unsigned i = 0; i < options.archives; ++i) {
+    readers.push_back(std::make_unique<fdb::Reader>(archive.c_str(), options.index ? index.c_str() : nullptr));
+    if (!*readers.back()) {
+      std::cerr << "can't open " << archive << std::endl;
+      return 1;
+    }
+    table += readers.back()->tableBytes();
+  }
+  const double opened = std::chrono::duration<double>(Clock::now() - start).count();
+  const auto after = memory();
+
+  // lookups touch the names, which is what brings the rest of a mapped index in
+  std::mt19937 rng(1);
+  std::vector<std::string> lookups;
+  for (int i = 0; i < 100000; ++i) {
+    auto n = name(rng() % options.entries);
+    for (auto& c : n) c = c == '\\' ? '/' : static_cast<char>(tolower(c));
+    lookups.push_back(std::move(n));
+  }
+  // the first lookup of a parsed table sorts its names, a mapped index comes sorted
+  const auto sortStart = Clock::now();
+  for (const auto& rd : readers) (void)rd->index("");
+  const double sorted = std::chrono::duration<double>(Clock::now() - sortStart).count();
+  const auto lookupStart = Clock::now();
+  std::uint64_t found = 0;
+  for (std::size_t i = 0; i < lookups.size(); ++i) {
+    found += readers[i % readers.size()]->index(lookups[i].c_str()) >= 0;
+  }
+  const double lookup = std::chrono::duration<double>(Clock::now() - lookupStart).count();
+  const auto touched = memory();
+
+  const double entries = double(options.entries) * options.archives;
+  std::cout << options.archives << " readers of " << options.entries << " entries"
+            << (options.index ? ", mapped index" : ", private tables") << std::endl;
+  std::cout << "open " << opened << " s, first lookup " << sorted << " s, " << (lookups.size() / lookup)
+            << " lookups/s, " << found << " found" << std::endl;
+  std::cout << "table " << (table / entries) << " bytes/entry, " << (table >> 20) << " MB" << std::endl;
+  if (after.resident) {
+    const auto owned = static_cast<double>(after.owned()) - static_cast<double>(before.owned());
+    const auto shared = static_cast<double>(after.shared) - static_cast<double>(before.shared);
+    std::cout << "private memory " << (owned / entries) << " bytes/entry, " << (owned / (1 << 20)) << " MB, shared "
+              << (shared / (1 << 20)) << " MB, " << ((double(touched.shared) - before.shared) / (1 << 20))
+              << " MB after lookups" << std::endl;
+  }
+
+  readers.clear();
+  std::filesystem::remove(archive);
+  std::filesystem::remove(index);
+  return found == lookups.size() ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+
+#include "args.hpp"
+#include "fdb/reader.hpp"
+#include "fdb/repack.hpp"
+#include "fdb/trace.hpp"
+
+namespace {
+  int usage() {
+    std::cerr << "usage: fdbrepack [--trace names.txt] [--access-trace recorded.trc]\n"
+                 "                 [--group original|offset|directory|extension]\n"
+                 "                 [--recompress] [--compression zlib|zstd|lz4] [-j threads] [--memory MB]\n"
+                 "                 [--format classic|extended]\n"
+                 "                 source.fdb target.fdb"
+              << std::endl;
+    return 2;
+  }
+}  // namespace
+
+int main(int argc, char** argv) {
+  fdb::RepackOptions options;
+  fdb::AccessTrace recorded;
+  int first = 1;
+  for (; first < argc && argv[first][0] == '-'; ++first) {
+    const bool hasValue = first + 1 < argc;
+    if (!strcmp(argv[first], "--trace") && hasValue) {
+      // one entry name per line, in the order they are loaded
+      std::ifstream f(argv[++first]);
+      for (std::string line; std::getline(f, line);) {
+        if (!line.empty()) options.trace.push_back(line);
+      }
+    } else if (!strcmp(argv[first], "--access-trace") && hasValue) {
+      // written by Reader::stopTrace() of an earlier run
+      if (!recorded.load(argv[++first])) return usage();
+    } else if (!strcmp(argv[first], "--group") && hasValue) {
+      const std::string g = argv[++first];
+      if (g == "original") {
+        options.grouping = fdb::RepackOptions::Grouping::original;
+      } else if (g == "offset") {
+        options.grouping = fdb::RepackOptions::Grouping::offset;
+      } else if (g == "directory") {
+        options.grouping = fdb::RepackOptions::Grouping::directory;
+      } else if (g == "extension") {
+        options.grouping = fdb::RepackOptions::Grouping::extension;
+      } else {
+        return usage();
+      }
+    } else if (!strcmp(argv[first], "--format") && hasValue) {
+      // the default grouping reorders payloads by directory, add --group original for a plain conversion
+      const std::string f = argv[++first];
+      if (f == "classic") {
+        options.format = fdb::Format::classic;
+      } else if (f == "extended") {
+        options.format = fdb::Format::extended;
+      } else {
+        return usage();
+      }
+    } else if (!strcmp(argv[first], "--recompress")) {
+      options.recompress = true;
+    } else if (!strcmp(argv[first], "--compression") && hasValue) {
+      // zstd and lz4 need --format extended
+      const std::string c = argv[++first];
+      if (c == "zlib") {
+        options.compression = fdb::Compression::zlib;
+      } else if (c == "zstd") {
+        options.compression = fdb::Compression::zstd;
+      } else if (c == "lz4") {
+        options.compression = fdb::Compression::lz4;
+      } else {
+        return usage();
+      }
+      options.recompress = true;
+    } else if (!strcmp(argv[first], "-j") && hasValue) {
+      if (!tools::positive(argv[++first], options.threads, 1024)) return usage();
+    } else if (!strcmp(argv[first], "--memory") && hasValue) {
+      std::size_t mb;
+      if (!tools::positive(argv[++first], mb, std::numeric_limits<std::size_t>::max() >> 20)) return usage();
+      options.memoryLimit = mb * 1024 * 1024;
+    } else {
+      return usage();
+    }
+  }
+  if (argc - first != 2) return usage();
+  if (!recorded.empty()) {
+    fdb::Reader rd(argv[first]);
+    for (const auto& r : recorded.records()) {
+      if (r.index < rd.size()) options.trace.push_back(rd.name(r.index));
+    }
+  }
+
+  fdb::RepackStats stats;
+  const bool ok = fdb::repack(argv[first], argv[first + 1], options, &stats);
+  std::cout << "entries=" << stats.entries << " empty=" << stats.empty << " recompressed=" << stats.recompressed
+            << " bytes_in=" << stats.bytesIn << " bytes_out=" << stats.bytesOut << " seconds=" << stats.seconds
+            << " status=" << (ok ? "ok" : "failed") << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,343 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "args.hpp"
+#include "fdb/ImageFile.hpp"
+#include "fdb/reader.hpp"
+
+// list, extract, stat and bench for archives, output is tab separated or key=value for scripts
+namespace {
+  using Clock = std::chrono::steady_clock;
+
+  struct Options {
+    std::string prefix;
+    std::string glob;
+    std::string output{"."};
+    unsigned threads{0};
+    std::uint32_t lookups{0};
+    bool details{false};
+    std::vector<const char*> archives;
+  };
+
+  int usage() {
+    std::cerr << "usage: fdbtool list [--prefix p] [--glob pattern] [-l] archive...\n"
+                 "       fdbtool extract [--prefix p] [--glob pattern] [-j threads] [-o dir] [--redux path] archive...\n"
+                 "       fdbtool stat [--prefix p] [--glob pattern] archive...\n"
+                 "       fdbtool bench [-j threads] [-n lookups] [--redux path] archive...\n"
+                 "names are matched after normalizing: lower case, / as separator, no leading ./"
+              << std::endl;
+    return 2;
+  }
+
+  double since(Clock::time_point start) { return std::chrono::duration<double>(Clock::now() - start).count(); }
+  unsigned threads(const Options& options) {
+    return options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  // the way the reader normalizes names, so filters can be given as they appear in the client
+  std::string normalize(std::string name) {
+    std::replace(name.begin(), name.end(), '\\', '/');
+    name.erase(name.begin(), std::find_if(name.begin(), name.end(), [](char c) { return c != '/' && c != '.'; }));
+    std::transform(name.begin(), name.end(), name.begin(), [](char c) {
+      return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    });
+    return name;
+  }
+  // * matches any run of characters including /, ? a single one
+  bool match(const char* pattern, const char* name) {
+    const char* star = nullptr;
+    const char* resume = nullptr;
+    while (*name) {
+      if (*pattern == '*') {
+        star = pattern++;
+        resume = name;
+      } else if (*pattern == '?' || *pattern == *name) {
+        ++pattern;
+        ++name;
+      } else if (star) {
+        pattern = star + 1;
+        name = ++resume;
+      } else {
+        return false;
+      }
+    }
+    while (*pattern == '*') ++pattern;
+    return *pattern == 0;
+  }
+  bool selected(const Options& options, const char* name) {
+    if (!options.prefix.empty() && strncmp(name, options.prefix.c_str(), options.prefix.size()) != 0) return false;
+    return options.glob.empty() || match(options.glob.c_str(), name);
+  }
+  // selected entries with a payload, in the order they are stored
+  std::vector<int> entries(const fdb::Reader& rd, const Options& options) {
+    std::vector<int> res;
+    for (std::uint32_t i = 0; i < rd.size(); ++i) {
+      if (rd.entry(i).offset != 0 && selected(options, rd.name(i))) res.push_back(i);
+    }
+    std::sort(res.begin(), res.end(), [&](int a, int b) { return rd.entry(a).offset < rd.entry(b).offset; });
+    return res;
+  }
+
+  const char* codec(fdb::Compression compression) {
+    switch (compression) {
+      case fdb::Compression::none:
+        return "none";
+      case fdb::Compression::rle:
+        return "rle";
+      case fdb::Compression::lzo:
+        return "lzo";
+      case fdb::Compression::zlib:
+        return "zlib";
+      case fdb::Compression::redux:
+        return "redux";
+      case fdb::Compression::zstd:
+        return "zstd";
+      case fdb::Compression::lz4:
+        return "lz4";
+    }
+    return "unknown";
+  }
+  std::string extension(const char* name) {
+    const char* dot = strrchr(name, '.');
+    const char* slash = strrchr(name, '/');
+    return dot && (!slash || dot > slash) ? dot + 1 : "";
+  }
+
+  // fn(index) on up to count threads, the entries are handed out in order so reads stay mostly sequential
+  template <typename Fn>
+  void parallel(const std::vector<int>& order, unsigned count, Fn&& fn) {
+    std::atomic<std::size_t> next{0};
+    auto run = [&] {
+      for (auto pos = next++; pos < order.size(); pos = next++) fn(order[pos]);
+    };
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < count; ++i) workers.emplace_back(run);
+    run();
+    for (auto& t : workers) t.join();
+  }
+
+  int list(const fdb::Reader& rd, const Options& options) {
+    for (std::uint32_t i = 0; i < rd.size(); ++i) {
+      if (!selected(options, rd.name(i))) continue;
+      if (!options.details) {
+        std::cout << rd.name(i) << '\n';
+        continue;
+      }
+      const auto info = rd.info(i);
+      const auto type = rd.entry(i).type;
+      std::cout << i << '\t' << (type == fdb::FileType::image ? "image" : "normal") << '\t' << codec(info.compression)
+                << '\t' << (info.compression == fdb::Compression::none ? info.expectedSize : info.compressedSize)
+                << '\t' << info.expectedSize << '\t' << info.time << '\t' << rd.name(i) << '\n';
+    }
+    return 0;
+  }
+
+  int extract(const fdb::Reader& rd, const Options& options) {
+    const auto order = entries(rd, options);
+    const std::filesystem::path root(options.output);
+    std::atomic<std::uint64_t> bytes{0};
+    std::atomic<std::uint32_t> failed{0};
+    std::mutex output;
+    auto fail = [&](int index, const char* why) {
+      std::lock_guard<std::mutex> l(output);
+      std::cerr << rd.name(index) << '\t' << why << std::endl;
+      ++failed;
+    };
+    const auto start = Clock::now();
+    parallel(order, threads(options), [&](int index) {
+      const std::filesystem::path name(rd.name(index));
+      // names come from the archive, none of them may leave the output directory
+      for (const auto& part : name) {
+        if (part == "..") return fail(index, "outside of the output directory");
+      }
+      const auto target = root / name;
+      std::error_code ec;
+      std::filesystem::create_directories(target.parent_path(), ec);
+      if (rd.entry(index).type == fdb::FileType::image) {
+        // images are converted back to their container format
+        auto file = rd.get(index);
+        if (!file || !file->toFile(target.string().c_str(), true)) return fail(index, "can't decode");
+        bytes += file->size();
+        return;
+      }
+      std::ofstream f(target, std::ios::binary | std::ios::trunc);
+      if (!f) return fail(index, "can't create");
+      std::uint64_t written = 0;
+      const bool ok = rd.stream(index, [&](const char* data, std::size_t size) {
+        written += size;
+        return static_cast<bool>(f.write(data, size));
+      });
+      if (!ok) {
+        f.close();
+        std::filesystem::remove(target, ec);
+        return fail(index, "can't decompress");
+      }
+      bytes += written;
+    });
+    const double seconds = since(start);
+    std::cout << "extracted=" << (order.size() - failed) << " failed=" << failed << " bytes=" << bytes
+              << " seconds=" << seconds << " mb_per_s=" << (bytes / seconds / (1 << 20)) << std::endl;
+    return failed ? 1 : 0;
+  }
+
+  int stat(const fdb::Reader& rd, const Options& options) {
+    struct Totals {
+      std::uint64_t count{0};
+      std::uint64_t stored{0};
+      std::uint64_t size{0};
+      void add(const fdb::FileInfo& info) {
+        ++count;
+        stored += info.compression == fdb::Compression::none ? info.expectedSize : info.compressedSize;
+        size += info.expectedSize;
+      }
+    };
+    std::map<std::string, Totals> extensions;
+    std::map<std::string, Totals> codecs;
+    Totals total;
+    std::uint64_t empty = 0;
+    for (std::uint32_t i = 0; i < rd.size(); ++i) {
+      if (!selected(options, rd.name(i))) continue;
+      if (rd.entry(i).offset == 0) {
+        ++empty;
+        continue;
+      }
+      const auto info = rd.info(i);
+      extensions[extension(rd.name(i))].add(info);
+      codecs[codec(info.compression)].add(info);
+      total.add(info);
+    }
+    auto print = [](const char* kind, const std::string& key, const Totals& t) {
+      std::cout << kind << '\t' << (key.empty() ? "-" : key) << '\t' << t.count << '\t' << t.stored << '\t' << t.size
+                << '\t' << (t.size ? double(t.stored) / t.size : 1.0) << '\n';
+    };
+    std::cout << "kind\tname\tcount\tstored\tsize\tratio\n";
+    for (const auto& e : extensions) print("extension", e.first, e.second);
+    for (const auto& c : codecs) print("codec", c.first, c.second);
+    print("total", "", total);
+    std::cout << "empty\t-\t" << empty << "\t0\t0\t1\n";
+    return 0;
+  }
+
+  int bench(const char* archive, const Options& options) {
+    // the best of a few opens, the first one may still have to pull the table from disk
+    double open = 1e9;
+    for (int i = 0; i < 3; ++i) {
+      const auto start = Clock::now();
+      fdb::Reader rd(archive);
+      open = std::min(open, since(start));
+    }
+    fdb::Reader rd(archive);
+    if (!rd) return 1;
+
+    std::vector<std::string> names;
+    for (std::uint32_t i = 0; i < rd.size(); ++i) names.emplace_back(rd.name(i));
+    std::shuffle(names.begin(), names.end(), std::mt19937(1));
+    // an empty archive has nothing to look up
+    double first = 0;
+    double lookup = 0;
+    std::uint32_t lookups = 0;
+    std::uint32_t found = 0;
+    auto start = Clock::now();
+    if (!names.empty()) {
+      (void)rd.index(names.front().c_str());
+      first = since(start);
+      lookups = options.lookups ? options.lookups : static_cast<std::uint32_t>(names.size());
+      start = Clock::now();
+      for (std::uint32_t i = 0; i < lookups; ++i) found += rd.index(names[i % names.size()].c_str()) >= 0;
+      lookup = since(start);
+    }
+
+    const auto order = entries(rd, Options());
+    std::atomic<std::uint64_t> stored{0};
+    start = Clock::now();
+    parallel(order, threads(options), [&](int index) {
+      auto file = rd.get(index);
+      if (file) stored += file->get().size();
+    });
+    const double read = since(start);
+
+    std::atomic<std::uint64_t> decompressed{0};
+    std::atomic<std::uint32_t> failed{0};
+    start = Clock::now();
+    parallel(order, threads(options), [&](int index) {
+      auto file = rd.get(index);
+      if (file && file->decompress()) {
+        decompressed += file->get().size();
+      } else {
+        ++failed;
+      }
+    });
+    const double decompress = since(start);
+
+    std::cout << archive << "\tentries=" << rd.size() << " open_ms=" << open * 1000 << " first_lookup_ms=" << first * 1000
+              << " lookups_per_s=" << (lookups ? lookups / lookup : 0) << " found=" << found << " read_mb_per_s="
+              << (stored / read / (1 << 20)) << " decompress_mb_per_s=" << (decompressed / decompress / (1 << 20))
+              << " undecodable=" << failed << " threads=" << threads(options) << std::endl;
+    return found == lookups ? 0 : 1;
+  }
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) return usage();
+  const std::string command = argv[1];
+  Options options;
+  for (int i = 2; i < argc; ++i) {
+    const bool hasValue = i + 1 < argc;
+    if (!strcmp(argv[i], "--prefix") && hasValue) {
+      options.prefix = normalize(argv[++i]);
+    } else if (!strcmp(argv[i], "--glob") && hasValue) {
+      options.glob = normalize(argv[++i]);
+    } else if (!strcmp(argv[i], "-o") && hasValue) {
+      options.output = argv[++i];
+    } else if (!strcmp(argv[i], "-j") && hasValue) {
+      if (!tools::positive(argv[++i], options.threads, 1024)) return usage();
+    } else if (!strcmp(argv[i], "-n") && hasValue) {
+      if (!tools::positive(argv[++i], options.lookups)) return usage();
+    } else if (!strcmp(argv[i], "-l")) {
+      options.details = true;
+    } else if (!strcmp(argv[i], "--redux") && hasValue) {
+      fdb::initRedux(argv[++i]);
+    } else if (argv[i][0] == '-') {
+      return usage();
+    } else {
+      options.archives.push_back(argv[i]);
+    }
+  }
+  if (options.archives.empty()) return usage();
+
+  int result = 0;
+  for (const char* archive : options.archives) {
+    if (command == "bench") {
+      result = std::max(result, bench(archive, options));
+      continue;
+    }
+    fdb::Reader rd(archive);
+    if (!rd) {
+      std::cerr << "can't open " << archive << std::endl;
+      result = 1;
+      continue;
+    }
+    if (command == "list") {
+      result = std::max(result, list(rd, options));
+    } else if (command == "extract") {
+      result = std::max(result, extract(rd, options));
+    } else if (command == "stat") {
+      result = std::max(result, stat(rd, options));
+    } else {
+      return usage();
+    }
+  }
+  return result;
+}
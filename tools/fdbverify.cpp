@@ -0,0 +1,46 @@
+#include <cstring>
+#include <iostream>
+
+#include "args.hpp"
+#include "fdb/ImageFile.hpp"
+#include "fdb/verify.hpp"
+
+namespace {
+  int usage() {
+    std::cerr << "usage: fdbverify [-j threads] [--structure-only] [--redux path] archive..." << std::endl;
+    return 2;
+  }
+}  // namespace
+
+int main(int argc, char** argv) {
+  fdb::VerifyOptions options;
+  int first = 1;
+  for (; first < argc && argv[first][0] == '-'; ++first) {
+    if (!strcmp(argv[first], "-j") && first + 1 < argc) {
+      if (!tools::positive(argv[++first], options.threads, 1024)) return usage();
+    } else if (!strcmp(argv[first], "--structure-only")) {
+      options.decompress = false;
+    } else if (!strcmp(argv[first], "--redux") && first + 1 < argc) {
+      fdb::initRedux(argv[++first]);
+    } else {
+      return usage();
+    }
+  }
+  if (first == argc) return usage();
+
+  bool ok = true;
+  for (int i = first; i < argc; ++i) {
+    const auto report = fdb::verify(argv[i], options);
+    // one line per issue, then a summary line per archive
+    for (const auto& issue : report.issues) {
+      std::cout << argv[i] << '\t' << issue.index << '\t' << fdb::toString(issue.problem) << '\t' << issue.message
+                << '\n';
+    }
+    std::cout << argv[i] << "\tentries=" << report.entries << " empty=" << report.empty
+              << " decompressed=" << report.decompressed << " stored_bytes=" << report.compressedBytes
+              << " uncompressed_bytes=" << report.uncompressedBytes << " issues=" << report.issues.size()
+              << " seconds=" << report.seconds << " status=" << (report.ok() ? "ok" : "damaged") << std::endl;
+    ok = ok && report.ok();
+  }
+  return ok ? 0 : 1;
+}